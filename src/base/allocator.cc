@@ -1,16 +1,14 @@
 #include "base/allocator.h"
 
-#include <algorithm>
-
 #include "base/base.h"
 
 namespace ppi {
 namespace base {
 
 // static member variables
-int64 Allocator::allocated_size_ = 0;
-int64 Allocator::allocated_size_peak_ = 0;
-int64 Allocator::allocated_number_ = 0;
+std::atomic<int64> Allocator::allocated_size_(0);
+std::atomic<int64> Allocator::allocated_size_peak_(0);
+std::atomic<int64> Allocator::allocated_number_(0);
 
 void* Allocator::AllocateInternal(int64 number) {
   uint64* ptr = new uint64[number + 1];
@@ -18,8 +16,11 @@ void* Allocator::AllocateInternal(int64 number) {
 
 #if !defined(BUILD_TYPE_release)
   ++allocated_number_;
-  allocated_size_ += (number + 1) * sizeof(int64);
-  allocated_size_peak_ = std::max(allocated_size_peak_, allocated_size_);
+  const int64 size = allocated_size_ += (number + 1) * sizeof(int64);
+  int64 peak = allocated_size_peak_;
+  while (peak < size &&
+         !allocated_size_peak_.compare_exchange_weak(peak, size)) {
+  }
 #endif
 
   return &ptr[1];
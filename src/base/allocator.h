@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+
 #include "base/base.h"
 
 namespace ppi {
@@ -24,9 +26,10 @@ class Allocator {
  private:
   static void* AllocateInternal(int64 number);
 
-  static int64 allocated_size_;
-  static int64 allocated_size_peak_;
-  static int64 allocated_number_;
+  // Allocations can happen in multiple threads.
+  static std::atomic<int64> allocated_size_;
+  static std::atomic<int64> allocated_size_peak_;
+  static std::atomic<int64> allocated_number_;
 };
 
 }  // namespace base
@@ -0,0 +1,79 @@
+#include "base/thread_pool.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace ppi {
+namespace base {
+
+ThreadPool::ThreadPool(int64 num_threads) : stop_(false) {
+  for (int64 i = 1; i < num_threads; ++i)
+    threads_.emplace_back([this] { Work(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& thread : threads_)
+    thread.join();
+}
+
+void ThreadPool::Run(std::vector<std::function<void()>>& tasks) {
+  if (tasks.empty())
+    return;
+
+  // |pending| is guarded by |mutex_|.
+  int64 pending = tasks.size() - 1;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 1; i < tasks.size(); ++i)
+      queue_.push_back({&tasks[i], &pending});
+  }
+  cv_.notify_all();
+
+  tasks[0]();
+
+  // Only tasks of this call are run while waiting.  Another task can be
+  // far larger than them, and would keep this call waiting after they
+  // finish.
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (pending > 0) {
+    auto it = std::find_if(queue_.rbegin(), queue_.rend(),
+                           [&pending](const Job& job) {
+                             return job.pending == &pending;
+                           });
+    if (it == queue_.rend()) {
+      cv_.wait(lock);
+      continue;
+    }
+    Job job = *it;
+    queue_.erase(std::next(it).base());
+    lock.unlock();
+    (*job.task)();
+    lock.lock();
+    --*job.pending;
+    cv_.notify_all();
+  }
+}
+
+void ThreadPool::Work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+    if (queue_.empty())
+      return;
+    Job job = queue_.front();
+    queue_.pop_front();
+    lock.unlock();
+    (*job.task)();
+    lock.lock();
+    --*job.pending;
+    cv_.notify_all();
+  }
+}
+
+}  // namespace base
+}  // namespace ppi
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/base.h"
+
+namespace ppi {
+namespace base {
+
+// ThreadPool runs tasks in fork-join style.  A thread waiting for its tasks
+// runs the ones still in the queue by itself, so nested Run() calls do not
+// dead-lock.  It never runs tasks of other Run() calls.  Idle workers steal
+// the oldest, i.e. the largest, tasks, while waiting threads take their
+// newest ones.
+class ThreadPool {
+ public:
+  // Uses |num_threads| threads, including the calling thread.
+  explicit ThreadPool(int64 num_threads);
+  ~ThreadPool();
+
+  int64 num_threads() const { return threads_.size() + 1; }
+
+  // Runs all |tasks|, and returns after all of them finish.
+  void Run(std::vector<std::function<void()>>& tasks);
+
+ private:
+  struct Job {
+    std::function<void()>* task;
+    int64* pending;
+  };
+
+  void Work();
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Job> queue_;
+  bool stop_;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace base
+}  // namespace ppi
@@ -0,0 +1,106 @@
+#include "base/thread_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "base/base.h"
+
+namespace ppi {
+namespace base {
+
+namespace {
+
+// IDs of Run() calls in progress in this thread, from the outermost one.
+thread_local std::vector<int64> g_runs;
+
+// Sums up [begin, end) with nested Run() calls, and checks that each task
+// runs in a worker, or in the thread which waits for it.
+int64 Sum(ThreadPool& pool,
+          int64 begin,
+          int64 end,
+          std::atomic<int64>* next_id,
+          std::atomic<int64>* misplaced) {
+  if (end - begin <= 4) {
+    int64 sum = 0;
+    for (int64 i = begin; i < end; ++i)
+      sum += i;
+    return sum;
+  }
+
+  const int64 id = (*next_id)++;
+  const int64 mid = (begin + end) / 2;
+  int64 sums[2] = {};
+  auto check = [id, misplaced] {
+    if (!g_runs.empty() && g_runs.back() != id)
+      ++*misplaced;
+  };
+  std::vector<std::function<void()>> tasks {
+    [&] {
+      check();
+      sums[0] = Sum(pool, begin, mid, next_id, misplaced);
+    },
+    [&] {
+      check();
+      sums[1] = Sum(pool, mid, end, next_id, misplaced);
+    },
+  };
+  g_runs.push_back(id);
+  pool.Run(tasks);
+  g_runs.pop_back();
+  return sums[0] + sums[1];
+}
+
+}  // namespace
+
+TEST(ThreadPoolTest, NestedRun) {
+  for (int64 num_threads : {1, 2, 4}) {
+    ThreadPool pool(num_threads);
+    std::atomic<int64> next_id(0);
+    std::atomic<int64> misplaced(0);
+    const int64 n = 100000;
+    EXPECT_EQ(n * (n - 1) / 2, Sum(pool, 0, n, &next_id, &misplaced))
+        << "with " << num_threads << " threads";
+    EXPECT_EQ(0, misplaced.load()) << "with " << num_threads << " threads";
+  }
+}
+
+TEST(ThreadPoolTest, SingleThreadRunsInline) {
+  ThreadPool pool(1);
+  EXPECT_EQ(1, pool.num_threads());
+
+  const std::thread::id caller = std::this_thread::get_id();
+  std::vector<int> order;
+  std::vector<std::function<void()>> tasks;
+  for (int i = 0; i < 10; ++i) {
+    tasks.push_back([&, i] {
+      EXPECT_EQ(caller, std::this_thread::get_id());
+      order.push_back(i);
+    });
+  }
+  pool.Run(tasks);
+  EXPECT_EQ(10u, order.size());
+}
+
+TEST(ThreadPoolTest, ManySmallTasks) {
+  ThreadPool pool(4);
+  EXPECT_EQ(4, pool.num_threads());
+
+  std::vector<int64> counts(10000);
+  std::vector<std::function<void()>> tasks;
+  for (size_t i = 0; i < counts.size(); ++i)
+    tasks.push_back([&counts, i] { ++counts[i]; });
+  for (int repeat = 0; repeat < 10; ++repeat)
+    pool.Run(tasks);
+  for (size_t i = 0; i < counts.size(); ++i)
+    EXPECT_EQ(10, counts[i]) << "for i = " << i;
+
+  std::vector<std::function<void()>> empty;
+  pool.Run(empty);
+}
+
+}  // namespace base
+}  // namespace ppi
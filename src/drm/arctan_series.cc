@@ -0,0 +1,64 @@
+#include "drm/arctan_series.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "base/base.h"
+#include "number/integer.h"
+#include "number/real.h"
+
+namespace ppi {
+namespace drm {
+
+ArctanSeries::ArctanSeries(uint64 x) : x_(x) {
+  DCHECK_GT(x, 1ULL);
+  DCHECK_EQ(x, x * x / x);
+}
+
+double ArctanSeries::postCompute(Real* a, Real* b, Real* val) {
+  // Only the leading limbs of a and b affect the result.
+  const int64 length = val->precision();
+  a->setPrecision(length + 1);
+  b->setPrecision(length + 1);
+
+  double error = 0;
+  error = std::max(error, Real::Inverse(*a, val));
+  error = std::max(error, Real::Mult(*val, *b, val));
+  return error;
+}
+
+int64 ArctanSeries::numTermsForDigits(int64 num_digits) {
+  return num_digits / std::log10(static_cast<double>(x_ * x_)) + 1;
+}
+
+void ArctanSeries::setValues(int64 n, Integer* a, Integer* b, Integer* c) {
+  // The k-th term is b[k] * \prod_{j<k} c[j] / \prod_{j<=k} a[j] with
+  //   a[0] = x, a[k] = (2k+1) x^2, b[k] = 1, c[k] = 2k+1,
+  // and Drm::internal() gives alternative signs.
+  if (n == 0) {
+    *a = x_;
+  } else {
+    *a = x_ * x_;
+    Integer::Mult(*a, 2 * n + 1, a);
+  }
+  *b = 1;
+  *c = 2 * n + 1;
+}
+
+bool ArctanSeries::setTerm(int64 n, Term* term) {
+  if (n == 0) {
+    term->multA(x_);
+  } else {
+    term->multA(x_);
+    term->multA(x_);
+    term->multA(2 * n + 1);
+  }
+  term->b = 1;
+  term->multC(2 * n + 1);
+  return true;
+}
+
+}  // namespace drm
+}  // namespace ppi
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "base/base.h"
+#include "drm/drm.h"
+#include "number/real.h"
+
+namespace ppi {
+namespace drm {
+
+using number::Integer;
+using number::Real;
+
+// Computes arctan(1/x) with binary splitting of
+//   \sum_k (-1)^k / ((2k+1) x^(2k+1)).
+class ArctanSeries : public Drm {
+ public:
+  explicit ArctanSeries(uint64 x);
+  ~ArctanSeries() = default;
+
+ private:
+  double postCompute(Real* a, Real* b, Real* val) override;
+
+  int64 numTermsForDigits(int64 num_digits) override;
+  void setValues(int64 n, Integer* a, Integer* b, Integer* c) override;
+  bool setTerm(int64 n, Term* term) override;
+
+  const uint64 x_;
+};
+
+}  // namespace drm
+}  // namespace ppi
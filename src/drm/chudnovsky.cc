@@ -13,31 +13,31 @@
 namespace ppi {
 namespace drm {
 
-double Chudnovsky::postCompute(Real* a, Real* b, Real* pi) {
-  Integer::Mult(*a, 640320ULL / 12 * 8 * 10005, a);
+double Chudnovsky::preCompute(int64 precision) {
+  base::Timer timer;
+  // postCompute() requires 1/sqrt(10005) only in a half precision.
+  inverse_sqrt_.setPrecision(precision / 2 + 3);
+  double error = Real::InverseSqrt(10005, &inverse_sqrt_);
+  timer.Stop();
+  LOG(INFO) << "Square Root: " << timer.GetTimeInSec() << " sec.";
+  return error;
+}
 
-  int64 length = std::max(a->size(), b->size()) + 1;
-  a->setPrecision(length);
-  pi->setPrecision(length);
+double Chudnovsky::postCompute(Real* a, Real* b, Real* pi) {
+  // pi = 426880 * sqrt(10005) * a / b
+  Integer::Mult(*a, 640320ULL / 12 * 8, a);
 
   double error = 0;
   {
     base::Timer timer;
-    error = std::max(error, Real::Inverse(*b, pi));
-    error = std::max(error, Real::Mult(*pi, *a, pi));
+    error = std::max(error, Real::Div(*a, *b, pi));
+    a->clear();
+    b->clear();
+    error = std::max(error, Real::MultSqrt(*pi, 10005, inverse_sqrt_, pi));
     timer.Stop();
     LOG(INFO) << "Division: " << timer.GetTimeInSec() << " sec.";
   }
-
-  a->clear();
-  b->setPrecision(length);
-  {
-    base::Timer timer;
-    error = std::max(error, Real::InverseSqrt(10005, b));
-    error = std::max(error, Real::Mult(*pi, *b, pi));
-    timer.Stop();
-    LOG(INFO) << "Square Root: " << timer.GetTimeInSec() << " sec.";
-  }
+  inverse_sqrt_.clear();
 
   return error;
 }
@@ -65,5 +65,26 @@ void Chudnovsky::setValues(int64 n, Integer* a, Integer* b, Integer* c) {
   Integer::Mult(*c, 2 * n + 1, c);
 }
 
+bool Chudnovsky::setTerm(int64 n, Term* term) {
+  // b = 13591409 + 545140134 * n must fit in a word.
+  if (n > static_cast<int64>((~0ULL - 13591409) / 545140134))
+    return false;
+
+  if (n == 0) {
+    term->multA(1);
+  } else {
+    // a = n^3 * 640320^3 / 24
+    term->multA(10939058860032000ULL);
+    term->multA(n);
+    term->multA(n);
+    term->multA(n);
+  }
+  term->b = 13591409 + n * 545140134;
+  term->multC(6 * n + 5);
+  term->multC(6 * n + 1);
+  term->multC(2 * n + 1);
+  return true;
+}
+
 }  // namespace drm
 }  // namespace ppi
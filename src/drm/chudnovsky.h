@@ -16,10 +16,15 @@ class Chudnovsky : public Drm {
   ~Chudnovsky() = default;
 
  private:
+  double preCompute(int64 precision) override;
   double postCompute(Real* a, Real* b, Real* pi) override;
 
   int64 numTermsForDigits(int64 num_digits) override;
   void setValues(int64 n, Integer* a, Integer* b, Integer* c) override;
+  bool setTerm(int64 n, Term* term) override;
+
+  // 1/sqrt(10005)
+  Real inverse_sqrt_;
 };
 
 }  // namespace drm
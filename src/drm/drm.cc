@@ -4,75 +4,386 @@
 
 #include <algorithm>
 #include <cmath>
+#include <functional>
+#include <memory>
+#include <vector>
 
 #include "base/base.h"
 #include "base/timer.h"
+#include "number/natural.h"
 #include "number/real.h"
 
 namespace ppi {
 namespace drm {
 
+namespace {
+
+// Subtrees with fewer pairs of terms are computed in a thread.
+constexpr int64 kMinParallelPairs = 64;
+// Products in a merge of more pairs are computed in parallel.
+constexpr int64 kMinParallelMergePairs = 1024;
+// Common factors are cancelled in merges of at most this number of pairs.
+constexpr int64 kMaxReducedPairs = 1024;
+
+// Packs |num| factors into words, and returns the number of words.
+int PackFactors(const uint64* factors, int num, uint64* words) {
+  int n = 0;
+  for (int i = 0; i < num; ++i) {
+    if (n > 0 && words[n - 1] <= ~0ULL / factors[i])
+      words[n - 1] *= factors[i];
+    else
+      words[n++] = factors[i];
+  }
+  return n;
+}
+
+}  // namespace
+
 double Drm::compute(const int64 num_dec, Real* pi) {
   const int64 num_hex = num_dec / std::log10(16) + 2;
   const int64 num_digits = num_hex / 16 + 2;
   const int64 num_terms = numTermsForDigits(num_dec);
   double error = 0;
+  double pre_error = 0;
 
-  int64 half = (num_terms + 1) / 2;
   LOG(INFO) << "Use " << num_terms << " terms to get " << num_dec << " digits.";
 
-  Real a, b, c;
-  {
-    base::Timer timer;
-    // Pass a, b, and c as Integer elements into binary split
-    error = std::max(error, internal(0, half, &a, &b, &c));
-    timer.Stop();
-    LOG(INFO) << "Binary Split: " << timer.GetTimeInSec() << " sec.";
-    LOG(INFO) << "Sizes: a(" << a.size() << "), b(" << b.size() << ")";
-  }
-  // c is no longer used.
-  c.clear();
+  Real a, b;
+  base::ThreadPool pool(num_threads_);
+  pool_ = (num_threads_ > 1) ? &pool : nullptr;
+  // Large products near the root, and in postCompute(), run their
+  // transforms in parallel in the same pool.
+  number::Natural::setThreadPool(pool_);
+  // Values depending only on the precision are computed concurrently with
+  // binary splitting.
+  std::vector<std::function<void()>> tasks {
+    [&] { error = binarySplit(num_terms, &a, &b); },
+    [&] { pre_error = preCompute(num_digits + 1); },
+  };
+  pool.Run(tasks);
+  pool_ = nullptr;
+  error = std::max(error, pre_error);
 
+  // postCompute() can refer the target precision with a guard limb.
+  pi->setPrecision(num_digits + 1);
   error = std::max(error, postCompute(&a, &b, pi));
   pi->setPrecision(num_digits);
+  number::Natural::setThreadPool(nullptr);
+  return error;
+}
+
+double Drm::binarySplit(const int64 num_terms, Integer* a, Integer* b) {
+  base::Timer timer;
+  const int64 half = (num_terms + 1) / 2;
+
+  std::unique_ptr<Sieve> sieve;
+  Term first, last;
+  if (reduce_factors_ && setTerm(1, &first) && setTerm(2 * half - 1, &last)) {
+    // Factors are expected to increase in terms, except for constants
+    // which appear in every term.  Constants are factorized by trial
+    // divisions.
+    std::vector<uint64> constants(first.a, first.a + first.num_a);
+    constants.insert(constants.end(), first.c, first.c + first.num_c);
+    std::vector<uint64> factors(last.a, last.a + last.num_a);
+    factors.insert(factors.end(), last.c, last.c + last.num_c);
+    uint64 limit = 1;
+    for (uint64 x : factors) {
+      if (std::find(constants.begin(), constants.end(), x) == constants.end())
+        limit = std::max(limit, x);
+    }
+    sieve.reset(new Sieve(limit));
+    sieve_ = sieve.get();
+  }
+  // c of the root is not used.
+  LevelErrors levels;
+  double error =
+      internal(0, half, 0, &levels, a, b, nullptr, nullptr, nullptr);
+  sieve_ = nullptr;
+
+  timer.Stop();
+  LOG(INFO) << "Binary Split: " << timer.GetTimeInSec() << " sec.";
+  LOG(INFO) << "Sizes: a(" << a->size() << "), b(" << b->size() << ")";
+  for (size_t depth = 0; depth < levels.errors.size(); ++depth) {
+    if (levels.errors[depth] == 0 && levels.recomputes[depth] == 0)
+      continue;
+    LOG(INFO) << "Maximum error in FFT at depth " << depth << ": "
+              << levels.errors[depth] << " (" << levels.recomputes[depth]
+              << " products recomputed)";
+  }
   return error;
 }
 
 double Drm::internal(int64 n0,
                      int64 n1,
+                     int depth,
+                     LevelErrors* levels,
                      Integer* a0,
                      Integer* b0,
-                     Integer* c0) {
+                     Integer* c0,
+                     Factors* fa0,
+                     Factors* fc0) {
   Integer a1, b1, c1;
-  if (n0 + 1 == n1) {
+  Integer unused_c;
+  const bool need_c = (c0 != nullptr);
+  if (!need_c)
+    c0 = &unused_c;
+
+  double error = 0;
+  if (2 * (n1 - n0) <= leaf_terms_ &&
+      computeLeaf(n0, n1, a0, b0, c0, fa0, fc0)) {
+    // Computed in words.
+  } else if (n0 + 1 == n1) {
     int64 n = 2 * n0;
     setValues(n, a0, b0, c0);
     setValues(n + 1, &a1, &b1, &c1);
 
-    Integer::Mult(*b0, a1, b0);
-    Integer::Mult(*c0, b1, &b1);
+    error = std::max(error, mult(depth, levels, *b0, a1, b0));
+    error = std::max(error, mult(depth, levels, *c0, b1, &b1));
     Integer::Subtract(*b0, b1, b0);
-    Integer::Mult(*a0, a1, a0);
-    Integer::Mult(*c0, c1, c0);
+    error = std::max(error, mult(depth, levels, *a0, a1, a0));
+    if (need_c)
+      error = std::max(error, mult(depth, levels, *c0, c1, c0));
   } else {
     int64 m = (n0 + n1) / 2;
-    internal(n0, m, a0, b0, c0);
-    internal(m, n1, &a1, &b1, &c1);
-
-    Integer::Mult(*b0, a1, b0);
-    Integer::Mult(*c0, b1, &b1);
-    Integer::Add(*b0, b1, b0);
-    Integer::Mult(*a0, a1, a0);
-    Integer::Mult(*c0, c1, c0);
+    // Factors of children are required to cancel their common factors.
+    Factors fa, fc, fa1, fc1;
+    const bool reduce = sieve_ && n1 - n0 <= kMaxReducedPairs;
+    if (reduce && !fa0) {
+      fa0 = &fa;
+      fc0 = &fc;
+    }
+    Factors* fa1p = reduce ? &fa1 : nullptr;
+    Factors* fc1p = reduce ? &fc1 : nullptr;
+    // c1 is required only if c of this node is required.
+    Integer* c1p = need_c ? &c1 : nullptr;
+
+    double errors[2] = {};
+    if (pool_ && n1 - n0 >= kMinParallelPairs) {
+      LevelErrors levels1;
+      std::vector<std::function<void()>> tasks {
+        [&] {
+          errors[0] =
+              internal(n0, m, depth + 1, levels, a0, b0, c0, fa0, fc0);
+        },
+        [&] {
+          errors[1] = internal(m, n1, depth + 1, &levels1, &a1, &b1, c1p,
+                               fa1p, fc1p);
+        },
+      };
+      pool_->Run(tasks);
+      levels->merge(levels1);
+    } else {
+      errors[0] = internal(n0, m, depth + 1, levels, a0, b0, c0, fa0, fc0);
+      errors[1] =
+          internal(m, n1, depth + 1, levels, &a1, &b1, c1p, fa1p, fc1p);
+    }
+    error = std::max(errors[0], errors[1]);
+
+    if (reduce) {
+      // a1 and c0 share factors, e.g. n in a(n) and 2n+1 in c(n/2).
+      // Dividing a, b, and c of this node by them keeps the series.
+      Factors gcd;
+      Factors::RemoveCommon(fc0, &fa1, &gcd);
+      if (!gcd.empty()) {
+        Factors::Div(*c0, gcd, c0);
+        Factors::Div(a1, gcd, &a1);
+      }
+      // fa0 and fc0 are referred only in merges of the parent.
+      if (fa0 != &fa) {
+        Factors::Mult(*fa0, fa1, &fa);
+        fa0->swap(fa);
+        if (need_c) {
+          Factors::Mult(*fc0, fc1, &fc);
+          fc0->swap(fc);
+        }
+      }
+    }
+    error = std::max(error,
+                     merge(depth, levels, a0, b0, c0, &a1, &b1, c1p,
+                           pool_ && n1 - n0 >= kMinParallelMergePairs));
   }
 
   VLOG(2) << n0 << " - " << n1;
   VLOG(2) << *a0;
   VLOG(2) << *b0;
-  VLOG(2) << *c0;
+  if (need_c)
+    VLOG(2) << *c0;
+
+  return error;
+}
+
+double Drm::merge(int depth,
+                  LevelErrors* levels,
+                  Integer* a0,
+                  Integer* b0,
+                  Integer* c0,
+                  Integer* a1,
+                  Integer* b1,
+                  Integer* c1,
+                  bool parallel) {
+  double errors[4] = {};
+  if (!parallel) {
+    errors[0] = mult(depth, levels, *b0, *a1, b0);
+    errors[1] = mult(depth, levels, *c0, *b1, b1);
+    Integer::Add(*b0, *b1, b0);
+    errors[2] = mult(depth, levels, *a0, *a1, a0);
+    if (c1)
+      errors[3] = mult(depth, levels, *c0, *c1, c0);
+    return *std::max_element(errors, errors + 4);
+  }
+
+  // Each product writes into an operand which no other product reads.
+  LevelErrors task_levels[4];
+  std::vector<std::function<void()>> tasks {
+    [=, &errors, &task_levels] {
+      errors[0] = mult(depth, &task_levels[0], *b0, *a1, b0);
+    },
+    [=, &errors, &task_levels] {
+      errors[1] = mult(depth, &task_levels[1], *c0, *b1, b1);
+    },
+    [=, &errors, &task_levels] {
+      errors[2] = mult(depth, &task_levels[2], *a0, *a1, a0);
+    },
+  };
+  if (c1) {
+    tasks.push_back([=, &errors, &task_levels] {
+      errors[3] = mult(depth, &task_levels[3], *c0, *c1, c1);
+    });
+  }
+  pool_->Run(tasks);
+  for (const LevelErrors& task_level : task_levels)
+    levels->merge(task_level);
+  Integer::Add(*b0, *b1, b0);
+  if (c1)
+    c0->swap(*c1);
+  return *std::max_element(errors, errors + 4);
+}
+
+double Drm::mult(int depth,
+                 LevelErrors* levels,
+                 const Integer& a,
+                 const Integer& b,
+                 Integer* c) {
+  if (error_threshold_ <= 0) {
+    const double error = Integer::Mult(a, b, c);
+    levels->record(depth, error, false);
+    return error;
+  }
+
+  // If |c| is an operand, it is kept until the product is accepted.
+  // Integer::Mult() computes such a product in a new buffer anyway.
+  const bool alias = (c == &a || c == &b);
+  Integer prod;
+  Integer* p = alias ? &prod : c;
+  double error = Integer::Mult(a, b, p);
+  const bool recompute = error > error_threshold_;
+  if (recompute) {
+    LOG(WARNING) << "Rounding error " << error << " in a product of "
+                 << a.size() << " x " << b.size() << " limbs at depth "
+                 << depth << " exceeds the threshold.";
+    error = Integer::MultInPieces(a, b, p);
+  }
+  if (alias)
+    c->swap(prod);
+  levels->record(depth, error, recompute);
+  return error;
+}
+
+void Drm::LevelErrors::record(int depth, double error, bool recomputed) {
+  if (static_cast<int>(errors.size()) <= depth) {
+    errors.resize(depth + 1, 0);
+    recomputes.resize(depth + 1, 0);
+  }
+  errors[depth] = std::max(errors[depth], error);
+  if (recomputed)
+    ++recomputes[depth];
+}
+
+void Drm::LevelErrors::merge(const LevelErrors& other) {
+  if (errors.size() < other.errors.size()) {
+    errors.resize(other.errors.size(), 0);
+    recomputes.resize(other.errors.size(), 0);
+  }
+  for (size_t depth = 0; depth < other.errors.size(); ++depth) {
+    errors[depth] = std::max(errors[depth], other.errors[depth]);
+    recomputes[depth] += other.recomputes[depth];
+  }
+}
+
+bool Drm::computeLeaf(int64 n0,
+                      int64 n1,
+                      Integer* a0,
+                      Integer* b0,
+                      Integer* c0,
+                      Factors* fa0,
+                      Factors* fc0) {
+  // Terms are representable up to some index, so the last one is checked
+  // too.  Otherwise the node falls back to setValues().
+  Term term;
+  if (!setTerm(2 * n1 - 1, &term))
+    return false;
+  term = Term();
+  if (!setTerm(2 * n0, &term))
+    return false;
+
+  uint64 a[Term::kMaxFactors];
+  uint64 c[Term::kMaxFactors];
+  int num_a = PackFactors(term.a, term.num_a, a);
+  int num_c = PackFactors(term.c, term.num_c, c);
+  *a0 = 1;
+  *b0 = term.b;
+  *c0 = 1;
+  for (int i = 0; i < num_a; ++i)
+    Integer::Mult(*a0, a[i], a0);
+  for (int i = 0; i < num_c; ++i)
+    Integer::Mult(*c0, c[i], c0);
+  if (fa0) {
+    fa0->clear();
+    fc0->clear();
+    factorize(term.a, term.num_a, fa0);
+    factorize(term.c, term.num_c, fc0);
+  }
 
-  return 0;
+  // Appending the k-th term,
+  //   a0 = a0 * a[k]
+  //   b0 = b0 * a[k] +- c0 * b[k]
+  //   c0 = c0 * c[k]
+  // where terms in odd k are subtracted.
+  for (int64 k = 2 * n0 + 1; k < 2 * n1; ++k) {
+    term = Term();
+    const bool representable = setTerm(k, &term);
+    DCHECK(representable);
+    num_a = PackFactors(term.a, term.num_a, a);
+    num_c = PackFactors(term.c, term.num_c, c);
+    for (int i = 0; i < num_a; ++i) {
+      Integer::Mult(*a0, a[i], a0);
+      Integer::Mult(*b0, a[i], b0);
+    }
+    if (k % 2)
+      Integer::MultSubtract(*c0, term.b, b0);
+    else
+      Integer::MultAdd(*c0, term.b, b0);
+    for (int i = 0; i < num_c; ++i)
+      Integer::Mult(*c0, c[i], c0);
+    if (fa0) {
+      factorize(term.a, term.num_a, fa0);
+      factorize(term.c, term.num_c, fc0);
+    }
+  }
+  if (fa0) {
+    fa0->normalize();
+    fc0->normalize();
+  }
+
+  return true;
 }
 
+void Drm::factorize(const uint64* factors, int num, Factors* fx) {
+  for (int i = 0; i < num; ++i)
+    sieve_->factorize(factors[i], fx);
+}
+
+constexpr int Drm::Term::kMaxFactors;
+
 }  // namespace drm
 }  // namespace ppi
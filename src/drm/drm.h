@@ -1,6 +1,12 @@
 #pragma once
 
+#include <glog/logging.h>
+
+#include <vector>
+
 #include "base/base.h"
+#include "base/thread_pool.h"
+#include "drm/factors.h"
 #include "number/real.h"
 
 namespace ppi {
@@ -14,18 +20,127 @@ class Drm {
   Drm() = default;
   virtual ~Drm() = default;
 
-  // Computes pi using DRM algorithm.
+  // Computes the value (e.g. pi) of the series in |num_digits| decimal
+  // digits using DRM algorithm.
   // Returns the maximum rounding error in multiplications.
   double compute(const int64 num_digits, Real* pi);
 
+  // Sets the number of terms computed at once in a leaf of binary splitting.
+  void setLeafTerms(int64 leaf_terms) { leaf_terms_ = leaf_terms; }
+  // Sets the number of threads to run binary splitting.
+  void setNumThreads(int64 num_threads) { num_threads_ = num_threads; }
+  // Sets whether to cancel common factors of a and c in merges of lower
+  // levels.  It requires setTerm().
+  void setReduceFactors(bool reduce) { reduce_factors_ = reduce; }
+  // Sets the rounding error in multiplications of binary splitting, over
+  // which products are recomputed with Integer::MultInPieces().  0 disables
+  // recomputations.
+  void setErrorThreshold(double threshold) { error_threshold_ = threshold; }
+
  protected:
+  // Describes the n-th term in words.  a and c are the products of their
+  // factors, and each factor fits in a word.
+  struct Term {
+    static constexpr int kMaxFactors = 8;
+
+    void multA(uint64 x) {
+      DCHECK_LT(num_a, kMaxFactors);
+      a[num_a++] = x;
+    }
+    void multC(uint64 x) {
+      DCHECK_LT(num_c, kMaxFactors);
+      c[num_c++] = x;
+    }
+
+    uint64 a[kMaxFactors];
+    int num_a = 0;
+    uint64 b = 0;
+    uint64 c[kMaxFactors];
+    int num_c = 0;
+  };
+
+  // Computes values which depend only on |precision|, e.g. constants
+  // used in postCompute().  It runs concurrently with binary splitting.
+  // Returns the maximum rounding error.
+  virtual double preCompute(int64 /* precision */) { return 0; }
   virtual double postCompute(Real*, Real*, Real*) { return 0; };
 
   virtual int64 numTermsForDigits(int64 num_digits) = 0;
   virtual void setValues(int64 n, Integer* a, Integer* b, Integer* c) = 0;
+  // Sets the n-th term in words, to compute leaves without multiplications
+  // of Integers.  Returns false if the term is not representable.
+  virtual bool setTerm(int64, Term*) { return false; }
 
  private:
-  double internal(int64 n0, int64 n1, Integer* a0, Integer* b0, Integer* c0);
+  // The maximum rounding error and the number of recomputed products in
+  // each depth of the binary splitting tree.  Each task records into its
+  // own, and they are merged after the task, without locks.
+  struct LevelErrors {
+    void record(int depth, double error, bool recomputed);
+    void merge(const LevelErrors& other);
+
+    std::vector<double> errors;
+    std::vector<int64> recomputes;
+  };
+
+  // Computes a and b of the series in |num_terms| terms.
+  double binarySplit(int64 num_terms, Integer* a, Integer* b);
+  // Computes values for terms [2*n0, 2*n1).  c0 can be null if the caller
+  // does not use it, e.g. on the right spine of the tree.  Divisors of a0
+  // and c0 are stored in |fa0| and |fc0| if they are not null.
+  // The node is in |depth| from the root, and errors in the subtree are
+  // recorded in |levels|.  Returns the maximum rounding error in the
+  // subtree.
+  double internal(int64 n0,
+                  int64 n1,
+                  int depth,
+                  LevelErrors* levels,
+                  Integer* a0,
+                  Integer* b0,
+                  Integer* c0,
+                  Factors* fa0,
+                  Factors* fc0);
+  // Computes a leaf of terms [2*n0, 2*n1) with word operations.
+  // Returns false if setTerm() is not available for the first or the last
+  // term.  Terms between them are assumed to be representable.
+  bool computeLeaf(int64 n0,
+                   int64 n1,
+                   Integer* a0,
+                   Integer* b0,
+                   Integer* c0,
+                   Factors* fa0,
+                   Factors* fc0);
+  // Appends factors of |num| words in |factors| to |fx|.
+  void factorize(const uint64* factors, int num, Factors* fx);
+
+  // Merges [n0, m) and [m, n1).  c is not computed if |c1| is null.
+  // The products are computed in parallel if |parallel| is true.
+  // Returns the maximum rounding error.
+  double merge(int depth,
+               LevelErrors* levels,
+               Integer* a0,
+               Integer* b0,
+               Integer* c0,
+               Integer* a1,
+               Integer* b1,
+               Integer* c1,
+               bool parallel);
+  // Computes c = a * b in a node in |depth|, and records the rounding
+  // error in |levels|.  A product whose error exceeds the threshold is
+  // recomputed.  |c| can be an operand.  Returns the rounding error.
+  double mult(int depth,
+              LevelErrors* levels,
+              const Integer& a,
+              const Integer& b,
+              Integer* c);
+
+  int64 leaf_terms_ = 32;
+  int64 num_threads_ = 1;
+  bool reduce_factors_ = false;
+  double error_threshold_ = 0;
+  // Available only in compute().
+  base::ThreadPool* pool_ = nullptr;
+  const Sieve* sieve_ = nullptr;
 };
 
 }  // namespace drm
@@ -0,0 +1,154 @@
+#include "drm/factors.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+#include "base/base.h"
+#include "number/integer.h"
+
+namespace ppi {
+namespace drm {
+
+namespace {
+
+// The maximum limit of sieves, to bound its memory.
+constexpr uint64 kMaxSieveLimit = 1ULL << 27;
+// Numbers over the limit are divided by primes up to this bound.
+constexpr uint64 kMaxTrialPrime = 1000;
+
+}  // namespace
+
+void Factors::normalize() {
+  std::sort(powers_.begin(), powers_.end(),
+            [](const Power& a, const Power& b) { return a.base < b.base; });
+  int64 n = 0;
+  for (const Power& p : powers_) {
+    if (n > 0 && powers_[n - 1].base == p.base)
+      powers_[n - 1].exp += p.exp;
+    else
+      powers_[n++] = p;
+  }
+  powers_.resize(n);
+}
+
+void Factors::Mult(const Factors& a, const Factors& b, Factors* c) {
+  DCHECK_NE(&a, c);
+  DCHECK_NE(&b, c);
+  const std::vector<Power>& pa = a.powers_;
+  const std::vector<Power>& pb = b.powers_;
+  std::vector<Power>& pc = c->powers_;
+  pc.clear();
+  pc.reserve(pa.size() + pb.size());
+
+  size_t i = 0, j = 0;
+  while (i < pa.size() && j < pb.size()) {
+    if (pa[i].base < pb[j].base) {
+      pc.push_back(pa[i++]);
+    } else if (pa[i].base > pb[j].base) {
+      pc.push_back(pb[j++]);
+    } else {
+      pc.push_back({pa[i].base, pa[i].exp + pb[j].exp});
+      ++i;
+      ++j;
+    }
+  }
+  pc.insert(pc.end(), pa.begin() + i, pa.end());
+  pc.insert(pc.end(), pb.begin() + j, pb.end());
+}
+
+void Factors::RemoveCommon(Factors* a, Factors* b, Factors* gcd) {
+  std::vector<Power>& pa = a->powers_;
+  std::vector<Power>& pb = b->powers_;
+  gcd->clear();
+
+  size_t i = 0, j = 0;
+  while (i < pa.size() && j < pb.size()) {
+    if (pa[i].base < pb[j].base) {
+      ++i;
+    } else if (pa[i].base > pb[j].base) {
+      ++j;
+    } else {
+      uint64 exp = std::min(pa[i].exp, pb[j].exp);
+      gcd->append(pa[i].base, exp);
+      pa[i++].exp -= exp;
+      pb[j++].exp -= exp;
+    }
+  }
+
+  auto is_one = [](const Power& p) { return p.exp == 0; };
+  pa.erase(std::remove_if(pa.begin(), pa.end(), is_one), pa.end());
+  pb.erase(std::remove_if(pb.begin(), pb.end(), is_one), pb.end());
+}
+
+void Factors::Div(const Integer& a, const Factors& b, Integer* c) {
+  if (c != &a)
+    *c = a;
+
+  // Divide by words packing the powers.
+  uint64 word = 1;
+  for (const Power& p : b.powers_) {
+    for (uint64 e = 0; e < p.exp; ++e) {
+      if (word > ~0ULL / p.base) {
+        Integer::Div(*c, word, c);
+        word = 1;
+      }
+      word *= p.base;
+    }
+  }
+  if (word > 1)
+    Integer::Div(*c, word, c);
+}
+
+Sieve::Sieve(uint64 limit) : limit_(std::min(limit, kMaxSieveLimit)) {
+  factor_.resize(limit_ / 2 + 1);
+  for (uint64 p = 3; p * p <= limit_; p += 2) {
+    if (factor_[p / 2])
+      continue;
+    for (uint64 q = p * p; q <= limit_; q += 2 * p) {
+      if (!factor_[q / 2])
+        factor_[q / 2] = p;
+    }
+  }
+  for (uint64 i = 0; i < factor_.size(); ++i) {
+    if (!factor_[i])
+      factor_[i] = 2 * i + 1;
+  }
+}
+
+void Sieve::factorize(uint64 x, Factors* factors) const {
+  if (x == 0)
+    return;
+
+  uint64 exp = 0;
+  while (x % 2 == 0) {
+    x /= 2;
+    ++exp;
+  }
+  if (exp)
+    factors->append(2, exp);
+
+  const uint64 max_prime = std::min(limit_, kMaxTrialPrime);
+  for (uint64 p = 3; x > limit_ && p <= max_prime && p * p <= x; p += 2) {
+    if (factor_[p / 2] != p)
+      continue;
+    for (exp = 0; x % p == 0; ++exp)
+      x /= p;
+    if (exp)
+      factors->append(p, exp);
+  }
+  if (x > limit_) {
+    factors->append(x, 1);
+    return;
+  }
+
+  while (x > 1) {
+    uint64 p = factor_[x / 2];
+    for (exp = 0; x % p == 0; ++exp)
+      x /= p;
+    factors->append(p, exp);
+  }
+}
+
+}  // namespace drm
+}  // namespace ppi
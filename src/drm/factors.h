@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+
+#include "base/base.h"
+#include "number/integer.h"
+
+namespace ppi {
+namespace drm {
+
+using number::Integer;
+
+// Factors represents a divisor of an integer as a product of powers,
+// sorted by their bases.  Bases are primes in most cases, but they can be
+// composite numbers which were not factorized.
+class Factors {
+ public:
+  struct Power {
+    uint64 base;
+    uint64 exp;
+  };
+
+  bool empty() const { return powers_.empty(); }
+  void clear() { powers_.clear(); }
+  void swap(Factors& other) { powers_.swap(other.powers_); }
+
+  // Appends base^exp.  Call normalize() after appending all the factors.
+  void append(uint64 base, uint64 exp) { powers_.push_back({base, exp}); }
+  // Sorts the powers and merges ones with the same base.
+  void normalize();
+
+  // Computes c = a * b.
+  static void Mult(const Factors& a, const Factors& b, Factors* c);
+  // Removes the common factors from |a| and |b|, and stores them in |gcd|.
+  static void RemoveCommon(Factors* a, Factors* b, Factors* gcd);
+  // Computes c = a / b.  The division must be exact.
+  static void Div(const Integer& a, const Factors& b, Integer* c);
+
+ private:
+  std::vector<Power> powers_;
+};
+
+// Sieve keeps the smallest prime factor of each odd number up to a limit,
+// to factorize numbers quickly.
+class Sieve {
+ public:
+  explicit Sieve(uint64 limit);
+
+  // Appends the factorization of |x| to |factors|.  If |x| exceeds the
+  // limit, only its small prime factors are factorized.
+  void factorize(uint64 x, Factors* factors) const;
+
+ private:
+  uint64 limit_;
+  // factor_[i] is the smallest prime factor of 2i+1.
+  std::vector<uint32> factor_;
+};
+
+}  // namespace drm
+}  // namespace ppi
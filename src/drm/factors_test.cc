@@ -0,0 +1,71 @@
+#include "drm/factors.h"
+
+#include <gtest/gtest.h>
+
+#include "base/base.h"
+#include "number/integer.h"
+
+namespace ppi {
+namespace drm {
+
+TEST(FactorsTest, RemoveCommon) {
+  Sieve sieve(100);
+
+  // 2^3 * 3^2 * 5 = 360, 3 * 5^2 * 7 = 525, gcd(360, 525) = 15
+  Factors a, b, gcd;
+  sieve.factorize(360, &a);
+  sieve.factorize(525, &b);
+  a.normalize();
+  b.normalize();
+  Factors::RemoveCommon(&a, &b, &gcd);
+
+  Integer x(360 * 1001);
+  Factors::Div(x, gcd, &x);
+  ASSERT_EQ(1, x.size());
+  EXPECT_EQ(24u * 1001, x[0]);
+
+  // No common factors remain.
+  Factors::RemoveCommon(&a, &b, &gcd);
+  EXPECT_TRUE(gcd.empty());
+}
+
+TEST(FactorsTest, FactorizeOverLimit) {
+  Sieve sieve(100);
+
+  // 10939058860032000 = 2^15 * 3^2 * 5^3 * 23^3 * 29^3
+  Factors a, b, gcd, prod;
+  sieve.factorize(10939058860032000ULL, &a);
+  sieve.factorize(23 * 23 * 1009, &b);
+  a.normalize();
+  b.normalize();
+  Factors::Mult(a, b, &prod);
+  Factors::RemoveCommon(&a, &prod, &gcd);
+  EXPECT_TRUE(a.empty());
+
+  Integer x(10939058860032000ULL);
+  Factors::Div(x, gcd, &x);
+  ASSERT_EQ(1, x.size());
+  EXPECT_EQ(1u, x[0]);
+}
+
+TEST(FactorsTest, DivMultiWords) {
+  Sieve sieve(1000);
+
+  Factors f;
+  Integer x(1);
+  for (uint64 p : {997, 991, 983, 977, 971, 967, 953, 947}) {
+    sieve.factorize(p, &f);
+    sieve.factorize(p, &f);
+    Integer::Mult(x, p * p, &x);
+  }
+  f.normalize();
+  Integer::Mult(x, 12345, &x);
+  ASSERT_LT(1, x.size());
+
+  Factors::Div(x, f, &x);
+  ASSERT_EQ(1, x.size());
+  EXPECT_EQ(12345u, x[0]);
+}
+
+}  // namespace drm
+}  // namespace ppi
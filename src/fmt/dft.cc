@@ -5,9 +5,12 @@
 #include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <functional>
+#include <vector>
 
 #include "base/allocator.h"
 #include "base/base.h"
+#include "base/thread_pool.h"
 
 namespace ppi {
 namespace fmt {
@@ -18,15 +21,40 @@ namespace {
 constexpr double M_PI = 3.141592653589793238;
 #endif
 
-Complex* g_work = nullptr;
+// Each thread keeps its own work area, so that transforms can run
+// concurrently.
+struct Work {
+  ~Work() { base::Allocator::Deallocate(area); }
+  Complex* area = nullptr;
+};
+thread_local Work g_work;
 
 Complex* WorkArea(int64 size) {
-  if (base::Allocator::GetSize(g_work) < size * 2) {
-    if (g_work)
-      base::Allocator::Deallocate(g_work);
-    g_work = base::Allocator::Allocate<Complex>(size * 2);
+  Complex*& work = g_work.area;
+  if (base::Allocator::GetSize(work) < size * 2) {
+    if (work)
+      base::Allocator::Deallocate(work);
+    work = base::Allocator::Allocate<Complex>(size * 2);
   }
-  return g_work;
+  return work;
+}
+
+// Calls |f| for ranges which cover [0, n), in tasks of |pool| if it is
+// not null.
+void ParallelFor(base::ThreadPool* pool,
+                 const int64 n,
+                 const std::function<void(int64, int64)>& f) {
+  if (!pool || pool->num_threads() == 1) {
+    f(0, n);
+    return;
+  }
+  // A few tasks for each thread balance loads of threads, which can be
+  // busy in other tasks.
+  const int64 num_tasks = std::min(n, pool->num_threads() * 4);
+  std::vector<std::function<void()>> tasks;
+  for (int64 i = 0; i < num_tasks; ++i)
+    tasks.push_back([&, i] { f(n * i / num_tasks, n * (i + 1) / num_tasks); });
+  pool->Run(tasks);
 }
 
 int64 GetExpOf2(const int64 n) {
@@ -257,7 +285,9 @@ Dft::Dft(const int64 n)
 
 Dft::Dft(const int64 n1, const int64 n2) : setting1_(n1), setting2_(n2) {}
 
-void Dft::Transform(const Direction dir, Complex* a) const {
+void Dft::Transform(const Direction dir,
+                    Complex* a,
+                    base::ThreadPool* pool) const {
   const int64 n = setting1_.n * setting2_.n;
   if (dir == Direction::Backward) {
     for (int64 i = 0; i < n; ++i) {
@@ -270,29 +300,37 @@ void Dft::Transform(const Direction dir, Complex* a) const {
     Complex* work = WorkArea(n);
     kernel(setting1_, work, a);
   } else {
-    // Run a six-step FFT.
+    // Run a six-step FFT.  Columns, and then rows, are independent, and
+    // are transformed in tasks of |pool|.  Each task has its own work
+    // area, because the work area of this thread keeps |temp|.
     const double theta = -2.0 * M_PI / n;
-    Complex* temp = WorkArea(n + (setting1_.n + 1) * 2);
-    Complex* work1 = temp + n;
-    Complex* work2 = work1 + setting1_.n + 1;
-    for (int64 i = 0; i < setting2_.n; ++i) {
-      for (int64 j = 0; j < setting1_.n; ++j) {
-        work1[j] = a[j * setting2_.n + i];
+    Complex* temp = WorkArea(n);
+    ParallelFor(pool, setting2_.n, [&](int64 begin, int64 end) {
+      std::vector<Complex> work((setting1_.n + 1) * 2);
+      Complex* work1 = work.data();
+      Complex* work2 = work1 + setting1_.n + 1;
+      for (int64 i = begin; i < end; ++i) {
+        for (int64 j = 0; j < setting1_.n; ++j) {
+          work1[j] = a[j * setting2_.n + i];
+        }
+        kernel(setting1_, work2, work1);
+        const double theta_i = theta * i;
+        for (int64 j = 0; j < setting1_.n; ++j) {
+          const double t = theta_i * j;
+          temp[j * setting2_.n + i] =
+              work1[j] * Complex{std::cos(t), std::sin(t)};
+        }
       }
-      kernel(setting1_, work2, work1);
-      const double theta_i = theta * i;
-      for (int64 j = 0; j < setting1_.n; ++j) {
-        const double t = theta_i * j;
-        temp[j * setting2_.n + i] =
-            work1[j] * Complex{std::cos(t), std::sin(t)};
+    });
+    ParallelFor(pool, setting1_.n, [&](int64 begin, int64 end) {
+      std::vector<Complex> work(setting2_.n);
+      for (int64 i = begin; i < end; ++i) {
+        kernel(setting2_, work.data(), temp + i * setting2_.n);
+        for (int64 j = 0; j < setting2_.n; ++j) {
+          a[j * setting1_.n + i] = temp[i * setting2_.n + j];
+        }
       }
-    }
-    for (int64 i = 0; i < setting1_.n; ++i) {
-      kernel(setting2_, work1, temp + i * setting2_.n);
-      for (int64 j = 0; j < setting2_.n; ++j) {
-        a[j * setting1_.n + i] = temp[i * setting2_.n + j];
-      }
-    }
+    });
   }
 
   if (dir == Direction::Backward) {
@@ -2,6 +2,7 @@
 
 #include "base/base.h"
 #include "base/complex.h"
+#include "base/thread_pool.h"
 #include "fmt/fmt.h"
 
 namespace ppi {
@@ -26,8 +27,11 @@ class Dft {
   // Forcibly use 6 step FFT, for tests.
   Dft(const int64 n1, const int64 m2);
 
-  // Compute DFT of |a|.
-  void Transform(const Direction, Complex* a) const;
+  // Compute DFT of |a|.  Passes of a six-step FFT run in tasks of |pool|,
+  // if it is given.
+  void Transform(const Direction,
+                 Complex* a,
+                 base::ThreadPool* pool = nullptr) const;
 
  private:
   static void kernel(const Setting& setting, Complex* work, Complex* a);
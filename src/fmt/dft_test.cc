@@ -4,6 +4,7 @@
 
 #include <vector>
 
+#include "base/thread_pool.h"
 #include "fmt/fmt.h"
 #include "fmt/rft.h"
 
@@ -74,5 +75,32 @@ TEST(DftTest, SixStepFftTest) {
   }
 }
 
+TEST(DftTest, SixStepFftInThreadPoolTest) {
+  base::ThreadPool pool(4);
+  const int64 n1 = 1 << 5;
+  const int64 n2 = 1 << 6;
+  const int64 n = n1 * n2;
+  Dft dft(n1, n2);
+  std::vector<Complex> a(n);
+  for (int i = 0; i < n; ++i) {
+    a[i].real = i;
+    a[i].imag = i + n;
+  }
+
+  // Passes in tasks compute the same values.
+  std::vector<Complex> b(a);
+  dft.Transform(Direction::Forward, a.data());
+  dft.Transform(Direction::Forward, b.data(), &pool);
+  for (int64 i = 0; i < n; ++i) {
+    ASSERT_EQ(a[i].real, b[i].real) << "index=" << i;
+    ASSERT_EQ(a[i].imag, b[i].imag) << "index=" << i;
+  }
+  dft.Transform(Direction::Backward, b.data(), &pool);
+  for (int64 i = 0; i < n; ++i) {
+    ASSERT_NEAR(i, b[i].real, 1e-10) << "index=" << i;
+    ASSERT_NEAR(i + n, b[i].imag, 1e-10) << "index=" << i;
+  }
+}
+
 }  // namespace fmt
 }  // namespace ppi
@@ -15,7 +15,9 @@ Rft::Rft(const int64 n) : Dft(n / 2), n_(n) {
 constexpr double M_PI = 3.141592653589793238;
 #endif
 
-void Rft::Transform(const Direction dir, double* a) const {
+void Rft::Transform(const Direction dir,
+                    double* a,
+                    base::ThreadPool* pool) const {
   Complex* ca = reinterpret_cast<Complex*>(a);
 
   if (dir == Direction::Backward) {
@@ -41,7 +43,7 @@ void Rft::Transform(const Direction dir, double* a) const {
     ca[n_ / 4].imag = -ca[n_ / 4].imag;
   }
 
-  Dft::Transform(dir, ca);
+  Dft::Transform(dir, ca, pool);
 
   if (dir == Direction::Forward) {
     double x0r = a[0];
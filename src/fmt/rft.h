@@ -14,8 +14,10 @@ class Rft : public Dft {
  public:
   Rft(const int64 n);
 
-  // Compute DFT of |a|.
-  void Transform(const Direction dir, double* a) const;
+  // Compute DFT of |a|.  See Dft::Transform() for |pool|.
+  void Transform(const Direction dir,
+                 double* a,
+                 base::ThreadPool* pool = nullptr) const;
 
  private:
   const int64 n_;
@@ -6,6 +6,8 @@
 #include <cinttypes>
 #include <cmath>
 #include <ostream>
+#include <utility>
+#include <vector>
 
 #include "base/base.h"
 #include "number/natural.h"
@@ -20,26 +22,50 @@ constexpr uint64 kHalfBitMask = (1ULL << kHalfSize) - 1;
 }  // namespace
 #endif
 
+constexpr int64 Integer::kInlineSize;
+
+std::atomic<bool> Integer::check_mult_(false);
+std::atomic<int64> Integer::recomputed_mults_(0);
+
 Integer::Integer(const Base base)
-    : data_(base::Allocator::Allocate<uint64>(0), &base::Allocator::Deallocate),
+    : buffer_(inline_),
+      capacity_(kInlineSize),
+      offset_(0),
+      size_(0),
       base_(base) {}
 
 Integer::Integer(uint64 value, const Base base)
-    : data_(base::Allocator::Allocate<uint64>(1), &base::Allocator::Deallocate),
+    : buffer_(inline_),
+      capacity_(kInlineSize),
+      offset_(0),
+      size_(1),
       base_(base) {
   (*this)[0] = value;
 }
 
 Integer::Integer(const Integer& other)
-    : data_(base::Allocator::Allocate<uint64>(other.size()),
-            &base::Allocator::Deallocate),
+    : buffer_(inline_),
+      capacity_(kInlineSize),
+      offset_(0),
+      size_(0),
       base_(other.base()) {
-  for (int64 i = 0; i < size(); ++i) {
-    (*this)[i] = other[i];
-  }
+  reset(other.size());
+  std::copy(other.data(), other.data() + size_, data());
 }
 
-Integer::~Integer() = default;
+Integer::Integer(Integer&& other)
+    : buffer_(inline_),
+      capacity_(kInlineSize),
+      offset_(0),
+      size_(0),
+      base_(other.base()) {
+  moveFrom(other);
+}
+
+Integer::~Integer() {
+  if (!isInline())
+    base::Allocator::Deallocate(buffer_);
+}
 
 void Integer::Normalize() {
   int64 i = size() - 1;
@@ -55,51 +81,78 @@ uint64 Integer::leading() const {
 }
 
 void Integer::resize(int64 sz) {
-  Digits new_ptr_impl(base::Allocator::Allocate<uint64>(sz),
-                      &base::Allocator::Deallocate);
-  uint64* new_ptr = new_ptr_impl.get();
-  if (data_) {
-    for (int64 i = 0; i < std::min(sz, size()); ++i)
-      new_ptr[i] = (*this)[i];
+  if (sz > capacity_) {
+    // Grow with a margin, so that repeated growth costs amortized O(1).
+    reserve(std::max(sz, capacity_ + capacity_ / 4));
+  } else {
+    reserve(sz);
+  }
+  size_ = sz;
+}
+
+void Integer::reset(int64 sz) {
+  if (sz > capacity_) {
+    if (!isInline())
+      base::Allocator::Deallocate(buffer_);
+    buffer_ = base::Allocator::Allocate<uint64>(sz);
+    capacity_ = sz;
   }
-  std::swap(data_, new_ptr_impl);
+  offset_ = 0;
+  size_ = sz;
+}
+
+void Integer::reserve(int64 cap) {
+  if (cap <= capacity())
+    return;
+
+  if (cap <= capacity_) {
+    // Move limbs to the head of the buffer.
+    std::copy(data(), data() + size_, buffer_);
+    offset_ = 0;
+    return;
+  }
+
+  uint64* buffer = base::Allocator::Allocate<uint64>(cap);
+  std::copy(data(), data() + size_, buffer);
+  if (!isInline())
+    base::Allocator::Deallocate(buffer_);
+  buffer_ = buffer;
+  capacity_ = cap;
+  offset_ = 0;
 }
 
 void Integer::erase(int64 begin, int64 end) {
   if (begin == end)
     return;
 
-  int64 erase_size = end - begin;
-  Digits new_ptr_impl(base::Allocator::Allocate<uint64>(size() - erase_size),
-                      &base::Allocator::Deallocate);
-  uint64* new_ptr = new_ptr_impl.get();
-  for (int64 i = 0; i < begin; ++i) {
-    new_ptr[i] = (*this)[i];
-  }
-  for (int64 i = end, j = begin; i < size(); ++i, ++j) {
-    new_ptr[j] = (*this)[i];
+  if (begin == 0) {
+    offset_ += end;
+  } else if (end < size_) {
+    std::copy(data() + end, data() + size_, data() + begin);
   }
-
-  std::swap(data_, new_ptr_impl);
+  size_ -= end - begin;
 }
 
 void Integer::clear() {
-  data_.reset(base::Allocator::Allocate<uint64>(0));
+  if (!isInline())
+    base::Allocator::Deallocate(buffer_);
+  buffer_ = inline_;
+  capacity_ = kInlineSize;
+  offset_ = size_ = 0;
 }
 
 void Integer::insert(int64 from, int64 number, uint64 value) {
-  Digits new_ptr_impl(base::Allocator::Allocate<uint64>(size() + number),
-                      &base::Allocator::Deallocate);
-  uint64* new_ptr = new_ptr_impl.get();
-
-  for (int64 i = 0; i < from; ++i)
-    new_ptr[i] = (*this)[i];
-  for (int64 i = 0; i < number; ++i)
-    new_ptr[i + from] = value;
-  for (int64 i = from + number, j = from; j < size(); ++i, ++j)
-    new_ptr[i] = (*this)[j];
-
-  std::swap(data_, new_ptr_impl);
+  if (from == 0 && number <= offset_) {
+    // Use the room in front of the limbs.
+    offset_ -= number;
+    size_ += number;
+  } else {
+    const int64 old_size = size_;
+    resize(old_size + number);
+    std::copy_backward(data() + from, data() + old_size,
+                       data() + old_size + number);
+  }
+  std::fill(data() + from, data() + from + number, value);
 }
 
 void Integer::push_leading(uint64 value) {
@@ -107,11 +160,49 @@ void Integer::push_leading(uint64 value) {
   (*this)[size() - 1] = value;
 }
 
+void Integer::swap(Integer& other) {
+  if (isInline() || other.isInline()) {
+    Integer tmp(std::move(other));
+    other.moveFrom(*this);
+    moveFrom(tmp);
+    return;
+  }
+
+  std::swap(buffer_, other.buffer_);
+  std::swap(capacity_, other.capacity_);
+  std::swap(offset_, other.offset_);
+  std::swap(size_, other.size_);
+}
+
+void Integer::moveFrom(Integer& other) {
+  DCHECK(isInline());
+  DCHECK_EQ(0, size_);
+
+  if (other.isInline()) {
+    std::copy(other.data(), other.data() + other.size_, inline_);
+    offset_ = 0;
+  } else {
+    buffer_ = other.buffer_;
+    capacity_ = other.capacity_;
+    offset_ = other.offset_;
+  }
+  size_ = other.size_;
+
+  other.buffer_ = other.inline_;
+  other.capacity_ = kInlineSize;
+  other.offset_ = other.size_ = 0;
+}
+
 // static
 void Integer::Add(const Integer& a, const Integer& b, Integer* c) {
   const int64 na = a.size();
   const int64 nb = b.size();
   const int64 n = std::min(na, nb);
+  // Keep a room for the carry.
+  if (c == &a || c == &b)
+    c->reserve(std::max(na, nb) + 1);
+  else
+    c->reset(std::max(na, nb) + 1);
   c->resize(std::max(na, nb));
 
   uint64 carry = Natural::Add(a.data(), b.data(), n, c->data());
@@ -129,7 +220,10 @@ void Integer::Subtract(const Integer& a, const Integer& b, Integer* c) {
   const int64 na = a.size();
   const int64 nb = b.size();
   CHECK_GE(na, nb);
-  c->resize(na);
+  if (c == &a || c == &b)
+    c->resize(na);
+  else
+    c->reset(na);
 
   uint64 carry = Natural::Subtract(a.data(), b.data(), nb, c->data());
   carry = Natural::Subtract(a.data() + nb, carry, na - nb, c->data() + nb);
@@ -150,6 +244,54 @@ int64 MinPow2(int64 n) {
   return *std::lower_bound(kCandidates, kCandidates + array_size(kCandidates),
                            n);
 }
+
+// Products of at least this number of limbs are checked in Mult(), if it
+// is enabled.
+constexpr int64 kMinCheckedLimbs = 64;
+// MultHalves() uses the schoolbook method, if an operand has at most this
+// number of limbs.
+constexpr int64 kMaxSchoolbookLimbs = 16;
+
+// Computes c[na+nb] = a[na] * b[nb] from products of halves of the longer
+// operand.  Each of them is computed in a shorter transform, and is checked
+// again.  Short products are computed exactly in the schoolbook method.
+// |c| must not overlap operands.  Returns the maximum error in rounding.
+double MultHalves(const uint64* a,
+                  int64 na,
+                  const uint64* b,
+                  int64 nb,
+                  uint64* c) {
+  if (na < nb) {
+    std::swap(a, b);
+    std::swap(na, nb);
+  }
+  std::fill(c, c + na + nb, 0);
+  if (nb <= kMaxSchoolbookLimbs) {
+    for (int64 i = 0; i < nb; ++i)
+      c[na + i] = Natural::MultAdd(a, b[i], na, c + i);
+    return 0;
+  }
+
+  double err = 0;
+  const int64 half = na / 2;
+  std::vector<uint64> prod;
+  for (int64 offset : {static_cast<int64>(0), half}) {
+    const int64 m = offset ? na - half : half;
+    const int64 n = MinPow2(m + nb);
+    prod.resize(n);
+    double e = Natural::Mult(a + offset, m, b, nb, n, prod.data());
+    if (!Natural::CheckMult(a + offset, m, b, nb, prod.data(), m + nb))
+      e = MultHalves(a + offset, m, b, nb, prod.data());
+    err = std::max(err, e);
+    // The upper half reaches the top of |c|, and the lower half adds to
+    // zeros, so no carries go out.
+    const uint64 carry =
+        Natural::Add(c + offset, prod.data(), m + nb, c + offset);
+    CHECK_EQ(0ULL, carry);
+  }
+  return err;
+}
+
 }  // namespace
 
 // static
@@ -157,9 +299,65 @@ double Integer::Mult(const Integer& a, const Integer& b, Integer* c) {
   const int64 na = a.size();
   const int64 nb = b.size();
   const int64 n = MinPow2(na + nb);
-  c->resize(n);
 
-  double err = Natural::Mult(a.data(), na, b.data(), nb, n, c->data());
+  // If |c| is an operand, compute the product in a new buffer, and then swap
+  // it with |c|'s.  Otherwise, |c|'s buffer is reused.
+  Integer prod;
+  Integer* p = (c == &a || c == &b) ? &prod : c;
+  p->reset(n);
+
+  double err = Natural::Mult(a.data(), na, b.data(), nb, n, p->data());
+  if (check_mult_ && na + nb >= kMinCheckedLimbs &&
+      !Natural::CheckMult(a.data(), na, b.data(), nb, p->data(), n)) {
+    LOG(WARNING) << "A product of " << na << " x " << nb << " limbs with "
+                 << "rounding error " << err << " failed the check.";
+    ++recomputed_mults_;
+    err = MultHalves(a.data(), na, b.data(), nb, p->data());
+    std::fill(p->data() + na + nb, p->data() + n, 0);
+  }
+  if (p != c)
+    c->swap(prod);
+
+  c->Normalize();
+
+  return err;
+}
+
+// static
+double Integer::MultInPieces(const Integer& a, const Integer& b, Integer* c) {
+  const int64 na = a.size();
+  const int64 nb = b.size();
+
+  Integer prod;
+  Integer* p = (c == &a || c == &b) ? &prod : c;
+  p->reset(na + nb);
+
+  double err = MultHalves(a.data(), na, b.data(), nb, p->data());
+  if (p != c)
+    c->swap(prod);
+
+  c->Normalize();
+
+  return err;
+}
+
+// static
+double Integer::MultMiddle(const Integer& a,
+                           const Integer& b,
+                           const int64 n,
+                           Integer* c) {
+  const int64 na = a.size();
+  const int64 nb = b.size();
+  DCHECK_EQ(n, MinPow2(n));
+  DCHECK_GE(n, std::max(na, nb));
+
+  Integer prod;
+  Integer* p = (c == &a || c == &b) ? &prod : c;
+  p->reset(n);
+
+  double err = Natural::Mult(a.data(), na, b.data(), nb, n, p->data());
+  if (p != c)
+    c->swap(prod);
 
   c->Normalize();
 
@@ -167,6 +365,11 @@ double Integer::Mult(const Integer& a, const Integer& b, Integer* c) {
 }
 
 void Integer::Mult(const Integer& a, const uint64 b, Integer* c) {
+  // Keep a room for the carry.
+  if (c == &a)
+    c->reserve(a.size() + 1);
+  else
+    c->reset(a.size() + 1);
   c->resize(a.size());
   uint64 carry = Natural::Mult(a.data(), b, a.size(), c->data());
   if (carry) {
@@ -174,6 +377,41 @@ void Integer::Mult(const Integer& a, const uint64 b, Integer* c) {
   }
 }
 
+void Integer::MultAdd(const Integer& a, const uint64 b, Integer* c) {
+  CHECK_NE(&a, c);
+  const int64 na = a.size();
+  const int64 nc = c->size();
+  if (nc < na) {
+    c->reserve(na + 1);
+    c->resize(na);
+    std::fill(c->data() + nc, c->data() + na, 0);
+  }
+
+  uint64 carry = Natural::MultAdd(a.data(), b, na, c->data());
+  for (int64 i = na; carry && i < c->size(); ++i) {
+    (*c)[i] += carry;
+    carry = ((*c)[i] < carry) ? 1 : 0;
+  }
+  if (carry)
+    c->push_leading(carry);
+}
+
+void Integer::MultSubtract(const Integer& a, const uint64 b, Integer* c) {
+  CHECK_NE(&a, c);
+  const int64 na = a.size();
+  CHECK_GE(c->size(), na);
+
+  uint64 borrow = Natural::MultSubtract(a.data(), b, na, c->data());
+  for (int64 i = na; borrow && i < c->size(); ++i) {
+    uint64 t = (*c)[i];
+    (*c)[i] = t - borrow;
+    borrow = (t < borrow) ? 1 : 0;
+  }
+  CHECK_EQ(0ULL, borrow);
+
+  c->Normalize();
+}
+
 namespace {
 
 uint64 getMSB(uint64 a) {
@@ -205,7 +443,8 @@ void Integer::Power(const uint64 a, const uint64 e, Integer* c) {
 }
 
 void Integer::Div(const Integer& a, const uint64 b, Integer* c) {
-  c->resize(a.size());
+  if (c != &a)
+    c->reset(a.size());
   Natural::Div(a.data(), b, a.size(), c->data());
   c->Normalize();
 }
@@ -214,7 +453,7 @@ void Integer::RBitShift(const Integer& a, const uint64 b, Integer* c) {
   CHECK_NE(&a, c);
   const uint64 limb_shift = b / 64;
   const uint64 bit_shift = b % 64;
-  c->resize(a.size() - limb_shift);
+  c->reset(a.size() - limb_shift);
 
   if (bit_shift == 0) {
     for (int64 i = 0; i < c->size(); ++i) {
@@ -240,7 +479,7 @@ void Integer::LBitShift(const Integer& a, const uint64 b, Integer* c) {
   const uint64 bit_shift = b % 64;
 
   if (bit_shift == 0) {
-    c->resize(a.size() + limb_shift);
+    c->reset(a.size() + limb_shift);
     for (int64 i = 0; i < limb_shift; ++i) {
       (*c)[i] = 0;
     }
@@ -250,7 +489,7 @@ void Integer::LBitShift(const Integer& a, const uint64 b, Integer* c) {
     return;
   }
 
-  c->resize(a.size() + limb_shift + 1);
+  c->reset(a.size() + limb_shift + 1);
   uint64 limb = 0;
   for (int64 i = 0; i < a.size(); ++i) {
     limb |= a[i] << bit_shift;
@@ -265,14 +504,26 @@ void Integer::LBitShift(const Integer& a, const uint64 b, Integer* c) {
 }
 
 Integer& Integer::operator=(const Integer& other) {
-  this->resize(other.size());
+  if (this == &other)
+    return (*this);
+
+  this->reset(other.size());
   for (int64 i = 0; i < size(); ++i)
     (*this)[i] = other[i];
   return (*this);
 }
 
+Integer& Integer::operator=(Integer&& other) {
+  if (this == &other)
+    return (*this);
+
+  clear();
+  moveFrom(other);
+  return (*this);
+}
+
 Integer& Integer::operator=(uint64 a) {
-  this->resize(1);
+  this->reset(1);
   (*this)[0] = a;
   return (*this);
 }
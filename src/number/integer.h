@@ -1,6 +1,6 @@
 #pragma once
 
-#include <memory>
+#include <atomic>
 #include <ostream>
 
 #include "base/allocator.h"
@@ -12,6 +12,9 @@ namespace number {
 // Represents a non negative integer in multiple precision format.
 class Integer {
  public:
+  // The number of limbs stored without allocations.
+  static constexpr int64 kInlineSize = 4;
+
   enum class Base : uint8 {
     kHex,
     kDecimal,
@@ -20,21 +23,33 @@ class Integer {
   Integer(const Base = Base::kHex);
   explicit Integer(uint64 value, const Base = Base::kHex);
   explicit Integer(const Integer& other);
+  Integer(Integer&& other);
   ~Integer();
 
   uint64& operator[](int64 i) const { return data()[i]; }
-  int64 size() const { return static_cast<int64>((*this)[-1]); }
-  uint64* data() const { return data_.get(); }
+  int64 size() const { return size_; }
+  uint64* data() const { return buffer_ + offset_; }
+  // The number of limbs storable without reallocation.
+  int64 capacity() const { return capacity_ - offset_; }
 
   uint64 leading() const;
+  // Resizes to |size| limbs.  The buffer is reallocated only if it is too
+  // small, and then it grows with a margin.
   void resize(int64 size);
+  // Resizes to |size| limbs without keeping the current limbs.
+  void reset(int64 size);
+  // Ensures capacity() >= |capacity|, keeping the current limbs.
+  void reserve(int64 capacity);
+  // Erasing limbs in the head or the tail costs O(1).
   void erase(int64 begin, int64 end);
+  // Releases the buffer.
   void clear();
   void insert(int64 from, int64 number, uint64 value);
   void push_leading(uint64 value);
   Base base() const { return base_; }
 
-  void release() { data_ = nullptr; }
+  // Swaps limbs with |other|.  The bases are not swapped.
+  void swap(Integer& other);
 
   // APIs -----------------------------------------------------------
   // Computes c[n] = a[n] + b[n]
@@ -47,10 +62,35 @@ class Integer {
   // which is greater than or equal to x.
   // Returns the maximum error in rounding.
   static double Mult(const Integer& a, const Integer& b, Integer* c);
+  // Sets whether Mult() checks products of large operands with
+  // Natural::CheckMult().  A product which fails the check is recomputed
+  // from products of halves in shorter transforms, which are checked again.
+  static void setCheckMult(bool check) { check_mult_ = check; }
+  // Returns the number of products recomputed after failed checks.
+  static int64 recomputed_mults() { return recomputed_mults_; }
+  // Computes c = a * b from products of halves of the longer operand,
+  // which have smaller rounding errors in shorter transforms.  Each of them
+  // is checked with Natural::CheckMult(), and is split again if it fails.
+  // Returns the maximum error in rounding.
+  static double MultInPieces(const Integer& a, const Integer& b, Integer* c);
+  // Computes c[n] = a * b in modulo 2^(64n)-1 with a cyclic convolution of
+  // n limbs, where n is a power of 2 and not less than sizes of a and b.
+  // Limbs of the product in [na+nb-n, n) are exact, and the others wrap
+  // around.  It is a middle product, if the leading limbs are known.
+  // Returns the maximum error in rounding.
+  static double MultMiddle(const Integer& a,
+                           const Integer& b,
+                           const int64 n,
+                           Integer* c);
 
   // Computes c[n] = a[n] * b.
   static void Mult(const Integer& a, const uint64 b, Integer* c);
 
+  // Computes c += a * b.  |c| must not be |a|.
+  static void MultAdd(const Integer& a, const uint64 b, Integer* c);
+  // Computes c -= a * b, assuming c >= a * b.  |c| must not be |a|.
+  static void MultSubtract(const Integer& a, const uint64 b, Integer* c);
+
   // Computes c[n] = a ** b.
   static void Power(const uint64 a, const uint64 b, Integer* c);
 
@@ -67,16 +107,30 @@ class Integer {
   static void Show(const Integer& val, std::ostream& os);
 
   Integer& operator=(const Integer& other);
+  Integer& operator=(Integer&& other);
   Integer& operator=(uint64 a);
 
  protected:
   void Normalize();
 
  private:
-  using Digits = std::unique_ptr<uint64, void (*)(void*)>;
-
-  Digits data_;
+  bool isInline() const { return buffer_ == inline_; }
+  // Takes the limbs of |other|, and leaves |other| empty.  This integer must
+  // be empty and must not own an allocated buffer.
+  void moveFrom(Integer& other);
+
+  static std::atomic<bool> check_mult_;
+  static std::atomic<int64> recomputed_mults_;
+
+  // The limbs are stored in buffer_[offset_, offset_ + size_), and
+  // buffer_ has capacity_ limbs.  Dropping low limbs just moves offset_.
+  // Small integers use inline_ as buffer_, and need no allocations.
+  uint64* buffer_;
+  int64 capacity_;
+  int64 offset_;
+  int64 size_;
   const Base base_;
+  uint64 inline_[kInlineSize];
 };
 
 std::ostream& operator<<(std::ostream& os, const Integer& val);
@@ -2,6 +2,9 @@
 
 #include <gtest/gtest.h>
 
+#include <utility>
+
+#include "base/allocator.h"
 #include "base/base.h"
 
 namespace ppi {
@@ -62,6 +65,82 @@ TEST(IntegerTest, LongMult) {
   EXPECT_EQ(0x664e97efa5291c0fULL, c[3]);
 }
 
+TEST(IntegerTest, CheckMult) {
+  Integer a, b, expect, c;
+  a.resize(1000);
+  b.resize(700);
+  for (int64 i = 0; i < a.size(); ++i)
+    a[i] = 0x123456789abcdefULL * (i + 1);
+  for (int64 i = 0; i < b.size(); ++i)
+    b[i] = ~0ULL - i;
+  Integer::Mult(a, b, &expect);
+
+  Integer::setCheckMult(true);
+  const int64 recomputed = Integer::recomputed_mults();
+  Integer::Mult(a, b, &c);
+  Integer::setCheckMult(false);
+
+  EXPECT_EQ(recomputed, Integer::recomputed_mults());
+  ASSERT_EQ(expect.size(), c.size());
+  for (int64 i = 0; i < c.size(); ++i) {
+    EXPECT_EQ(expect[i], c[i]) << "for i = " << i;
+  }
+}
+
+TEST(IntegerTest, MultInPieces) {
+  Integer a, b, expect;
+  a.resize(1000);
+  b.resize(300);
+  for (int64 i = 0; i < a.size(); ++i)
+    a[i] = 0x123456789abcdefULL * (i + 1);
+  for (int64 i = 0; i < b.size(); ++i)
+    b[i] = ~0ULL - i;
+  Integer::Mult(a, b, &expect);
+
+  // The output can be an operand.
+  Integer c(a);
+  Integer::MultInPieces(c, b, &c);
+  ASSERT_EQ(expect.size(), c.size());
+  for (int64 i = 0; i < c.size(); ++i) {
+    EXPECT_EQ(expect[i], c[i]) << "for i = " << i;
+  }
+}
+
+TEST(IntegerTest, MultMiddle) {
+  const int64 n = 8;
+  Integer a, b, c, prod;
+  a.resize(6);
+  for (int64 i = 0; i < a.size(); ++i)
+    a[i] = ~0ULL - i;
+  b.resize(5);
+  for (int64 i = 0; i < b.size(); ++i)
+    b[i] = 0xfedcba9876543210ULL * (i + 1);
+
+  Integer::MultMiddle(a, b, n, &c);
+  Integer::Mult(a, b, &prod);
+
+  // Fold the product in modulo 2^(64n)-1.
+  Integer low, high, sum, expect;
+  low.resize(n);
+  for (int64 i = 0; i < n; ++i)
+    low[i] = prod[i];
+  high.resize(prod.size() - n);
+  for (int64 i = n; i < prod.size(); ++i)
+    high[i - n] = prod[i];
+  Integer::Add(low, high, &sum);
+  if (sum.size() > n) {
+    sum.erase(n, n + 1);
+    Integer::Add(sum, Integer(1), &expect);
+  } else {
+    expect.swap(sum);
+  }
+
+  ASSERT_EQ(expect.size(), c.size());
+  for (int64 i = 0; i < c.size(); ++i) {
+    EXPECT_EQ(expect[i], c[i]) << "for i = " << i;
+  }
+}
+
 TEST(IntegerTest, Add) {
   Integer a(1ULL << 63);
   EXPECT_EQ(1, a.size());
@@ -79,6 +158,133 @@ TEST(IntegerTest, MultWithUint64) {
   EXPECT_EQ(1ULL, a[1]);
 }
 
+TEST(IntegerTest, MoveAndSwap) {
+  // A large integer moves its buffer.
+  Integer large;
+  large.resize(Integer::kInlineSize + 1);
+  const uint64* data = large.data();
+  Integer moved(std::move(large));
+  EXPECT_EQ(0, large.size());
+  EXPECT_EQ(Integer::kInlineSize + 1, moved.size());
+  EXPECT_EQ(data, moved.data());
+
+  Integer a(0x1234ULL);
+  Integer b(std::move(a));
+  EXPECT_EQ(0, a.size());
+  ASSERT_EQ(1, b.size());
+  EXPECT_EQ(0x1234ULL, b[0]);
+
+  Integer c;
+  c = std::move(b);
+  EXPECT_EQ(0, b.size());
+  ASSERT_EQ(1, c.size());
+  EXPECT_EQ(0x1234ULL, c[0]);
+
+  Integer d(0x5678ULL);
+  d.push_leading(1);
+  c.swap(d);
+  ASSERT_EQ(2, c.size());
+  EXPECT_EQ(0x5678ULL, c[0]);
+  EXPECT_EQ(1ULL, c[1]);
+  ASSERT_EQ(1, d.size());
+  EXPECT_EQ(0x1234ULL, d[0]);
+
+  // Swap between inline and allocated limbs.
+  c.swap(moved);
+  EXPECT_EQ(Integer::kInlineSize + 1, c.size());
+  EXPECT_EQ(data, c.data());
+  ASSERT_EQ(2, moved.size());
+  EXPECT_EQ(0x5678ULL, moved[0]);
+  EXPECT_EQ(1ULL, moved[1]);
+}
+
+TEST(IntegerTest, SmallWithoutAllocation) {
+  // Prepare the work area for multiplications in advance.
+  Integer w0(1), w1(1);
+  Integer::Mult(w0, w1, &w0);
+
+  const int64 allocated = base::Allocator::allocated_number();
+  Integer a(640320ULL);
+  Integer b(6 * 640320ULL + 5);
+  Integer::Mult(a, b, &a);
+  Integer::Mult(a, 13591409ULL, &a);
+  Integer c(a);
+  EXPECT_EQ(allocated, base::Allocator::allocated_number());
+}
+
+TEST(IntegerTest, EraseAndInsert) {
+  Integer a;
+  a.resize(4);
+  for (int64 i = 0; i < 4; ++i)
+    a[i] = i + 1;
+  const int64 capacity = a.capacity();
+
+  // Erasing low limbs does not reallocate.
+  const uint64* data = a.data();
+  a.erase(0, 2);
+  ASSERT_EQ(2, a.size());
+  EXPECT_EQ(data + 2, a.data());
+  EXPECT_EQ(3ULL, a[0]);
+  EXPECT_EQ(4ULL, a[1]);
+  EXPECT_EQ(capacity - 2, a.capacity());
+
+  // Inserting low limbs reuses the room.
+  a.insert(0, 1, 0);
+  ASSERT_EQ(3, a.size());
+  EXPECT_EQ(data + 1, a.data());
+  EXPECT_EQ(0ULL, a[0]);
+  EXPECT_EQ(3ULL, a[1]);
+  EXPECT_EQ(4ULL, a[2]);
+
+  a.insert(1, 2, 9);
+  ASSERT_EQ(5, a.size());
+  EXPECT_EQ(0ULL, a[0]);
+  EXPECT_EQ(9ULL, a[1]);
+  EXPECT_EQ(9ULL, a[2]);
+  EXPECT_EQ(3ULL, a[3]);
+  EXPECT_EQ(4ULL, a[4]);
+
+  a.erase(1, 3);
+  ASSERT_EQ(3, a.size());
+  EXPECT_EQ(0ULL, a[0]);
+  EXPECT_EQ(3ULL, a[1]);
+  EXPECT_EQ(4ULL, a[2]);
+}
+
+TEST(IntegerTest, PushLeadingInCapacity) {
+  Integer a;
+  a.reserve(10);
+  const uint64* data = a.data();
+  for (int64 i = 0; i < 10; ++i)
+    a.push_leading(i);
+  EXPECT_EQ(data, a.data());
+  ASSERT_EQ(10, a.size());
+  for (int64 i = 0; i < 10; ++i)
+    EXPECT_EQ(static_cast<uint64>(i), a[i]);
+}
+
+TEST(IntegerTest, MultInPlace) {
+  Integer a, b, c;
+  a.push_leading(0xba686c78678e686bULL);
+  a.push_leading(0xac7d868e97d8a076ULL);
+  b.push_leading(0x7868d76876b876e8ULL);
+  b.push_leading(0x97d6897c7d8976e7ULL);
+  Integer::Mult(a, b, &c);
+
+  Integer::Mult(a, b, &a);
+  ASSERT_EQ(c.size(), a.size());
+  for (int64 i = 0; i < c.size(); ++i)
+    EXPECT_EQ(c[i], a[i]);
+
+  Integer::Mult(a, a, &a);
+  Integer::Mult(c, c, &c);
+  Integer::Mult(b, a, &a);
+  Integer::Mult(b, c, &c);
+  ASSERT_EQ(c.size(), a.size());
+  for (int64 i = 0; i < c.size(); ++i)
+    EXPECT_EQ(c[i], a[i]);
+}
+
 TEST(IntegerTest, Power) {
   Integer p10;
   Integer::Power(10000000000000000000ULL, 10, &p10);  // 10^19
@@ -0,0 +1,128 @@
+#include "number/mult_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace ppi {
+namespace number {
+
+namespace {
+
+// Transform lengths are powers of 2, and are indexed with their exponents.
+constexpr int kMaxLog2Length = 64;
+
+struct Counters {
+  std::atomic<int64> count;
+  std::atomic<int64> nanoseconds;
+  std::atomic<double> max_error;
+  std::atomic<int64> buckets[MultStats::kNumErrorBuckets];
+};
+
+// Zero-initialized as a static object.
+Counters g_counters[kMaxLog2Length];
+
+int Log2(int64 length) {
+  int k = 0;
+  while (k + 1 < kMaxLog2Length && (1LL << (k + 1)) <= length)
+    ++k;
+  return k;
+}
+
+}  // namespace
+
+constexpr int MultStats::kBucketsPerOctave;
+constexpr int MultStats::kMinErrorExponent;
+constexpr int MultStats::kNumErrorBuckets;
+
+std::atomic<bool> MultStats::enabled_(false);
+
+double MultStats::Entry::Percentile(double p) const {
+  const int64 target = std::max<int64>(1, std::ceil(count * p / 100));
+  int64 sum = 0;
+  for (int i = 0; i < kNumErrorBuckets; ++i) {
+    sum += buckets[i];
+    if (sum >= target)
+      return std::min(BucketLimit(i), max_error);
+  }
+  return max_error;
+}
+
+void MultStats::Record(int64 length, double seconds, double error) {
+  Counters& counters = g_counters[Log2(length)];
+  counters.count.fetch_add(1, std::memory_order_relaxed);
+  counters.nanoseconds.fetch_add(static_cast<int64>(seconds * 1e9),
+                                 std::memory_order_relaxed);
+  double max_error = counters.max_error.load(std::memory_order_relaxed);
+  while (error > max_error &&
+         !counters.max_error.compare_exchange_weak(
+             max_error, error, std::memory_order_relaxed)) {
+  }
+  counters.buckets[Bucket(error)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void MultStats::Reset() {
+  for (Counters& counters : g_counters) {
+    counters.count = 0;
+    counters.nanoseconds = 0;
+    counters.max_error = 0;
+    for (auto& bucket : counters.buckets)
+      bucket = 0;
+  }
+}
+
+std::vector<MultStats::Entry> MultStats::Snapshot() {
+  std::vector<Entry> entries;
+  for (int k = 0; k < kMaxLog2Length; ++k) {
+    const Counters& counters = g_counters[k];
+    Entry entry;
+    entry.count = counters.count.load(std::memory_order_relaxed);
+    if (entry.count == 0)
+      continue;
+    entry.length = 1LL << k;
+    entry.seconds = counters.nanoseconds.load(std::memory_order_relaxed) * 1e-9;
+    entry.max_error = counters.max_error.load(std::memory_order_relaxed);
+    for (int i = 0; i < kNumErrorBuckets; ++i)
+      entry.buckets[i] = counters.buckets[i].load(std::memory_order_relaxed);
+    entries.push_back(entry);
+  }
+  return entries;
+}
+
+void MultStats::Dump(std::ostream& os) {
+  char line[128];
+  std::snprintf(line, sizeof(line), "%12s %10s %12s %12s %12s %12s\n",
+                "FFT length", "calls", "time (sec)", "p50 error",
+                "p99 error", "max error");
+  os << line;
+  for (const Entry& entry : Snapshot()) {
+    std::snprintf(line, sizeof(line),
+                  "%12lld %10lld %12.3f %12.4g %12.4g %12.4g\n",
+                  static_cast<long long>(entry.length),
+                  static_cast<long long>(entry.count), entry.seconds,
+                  entry.Percentile(50), entry.Percentile(99), entry.max_error);
+    os << line;
+  }
+}
+
+int MultStats::Bucket(double error) {
+  if (!(error > 0))
+    return 0;
+  // error = m * 2^e, where 0.5 <= m < 1.
+  int e;
+  const double m = std::frexp(error, &e);
+  const int octave = e - 1 - kMinErrorExponent;
+  const int sub = static_cast<int>((m - 0.5) * 2 * kBucketsPerOctave);
+  return std::max(0, std::min(kNumErrorBuckets - 1,
+                              octave * kBucketsPerOctave + sub));
+}
+
+double MultStats::BucketLimit(int bucket) {
+  const int octave = bucket / kBucketsPerOctave;
+  const int sub = bucket % kBucketsPerOctave;
+  return std::ldexp(1.0 + (sub + 1.0) / kBucketsPerOctave,
+                    octave + kMinErrorExponent);
+}
+
+}  // namespace number
+}  // namespace ppi
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <ostream>
+#include <vector>
+
+#include "base/base.h"
+
+namespace ppi {
+namespace number {
+
+// MultStats counts multiplications with FFT for each transform length,
+// with their cumulative time and a histogram of rounding errors.
+// Counters are updated with relaxed atomic operations, and nothing is
+// measured while it is disabled.
+class MultStats {
+ public:
+  // Errors are bucketed in 4 buckets for each power of 2, down to 2^-32.
+  static constexpr int kBucketsPerOctave = 4;
+  static constexpr int kMinErrorExponent = -32;
+  static constexpr int kNumErrorBuckets = 36 * kBucketsPerOctave;
+
+  // Statistics of a transform length.
+  struct Entry {
+    // The number of doubles in a transform.
+    int64 length;
+    int64 count;
+    double seconds;
+    double max_error;
+    int64 buckets[kNumErrorBuckets];
+
+    // Returns an upper bound of the |p|-th percentile error, where
+    // 0 < p <= 100.
+    double Percentile(double p) const;
+  };
+
+  static void setEnabled(bool enabled) { enabled_ = enabled; }
+  static bool enabled() { return enabled_; }
+
+  // Records a transform of |length| doubles, which took |seconds| and had
+  // a rounding error |error|.
+  static void Record(int64 length, double seconds, double error);
+  static void Reset();
+  // Returns entries of used lengths in the ascending order.
+  static std::vector<Entry> Snapshot();
+  // Writes a line for each length in a table.
+  static void Dump(std::ostream& os);
+
+  // Returns the index of the bucket for |error|, and the exclusive upper
+  // bound of errors in a bucket.
+  static int Bucket(double error);
+  static double BucketLimit(int bucket);
+
+ private:
+  static std::atomic<bool> enabled_;
+};
+
+}  // namespace number
+}  // namespace ppi
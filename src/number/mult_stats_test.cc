@@ -0,0 +1,75 @@
+#include "number/mult_stats.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <vector>
+
+#include "base/base.h"
+#include "number/natural.h"
+
+namespace ppi {
+namespace number {
+
+TEST(MultStatsTest, Bucket) {
+  EXPECT_EQ(0, MultStats::Bucket(0));
+  EXPECT_EQ(0, MultStats::Bucket(1e-20));
+  for (double error : {1e-9, 3e-5, 0.1, 0.25, 0.4999}) {
+    const int bucket = MultStats::Bucket(error);
+    EXPECT_LT(error, MultStats::BucketLimit(bucket)) << error;
+    EXPECT_GE(error, MultStats::BucketLimit(bucket - 1)) << error;
+  }
+  EXPECT_LT(MultStats::Bucket(0.1), MultStats::Bucket(0.2));
+}
+
+TEST(MultStatsTest, Record) {
+  MultStats::Reset();
+  for (int i = 0; i < 98; ++i)
+    MultStats::Record(1024, 0.01, 1e-6);
+  MultStats::Record(1024, 0.01, 1e-3);
+  MultStats::Record(1024, 0.01, 0.1);
+  MultStats::Record(64, 0.5, 0.0);
+
+  std::vector<MultStats::Entry> entries = MultStats::Snapshot();
+  ASSERT_EQ(2U, entries.size());
+  EXPECT_EQ(64, entries[0].length);
+  EXPECT_EQ(1, entries[0].count);
+  EXPECT_EQ(0, entries[0].max_error);
+
+  const MultStats::Entry& entry = entries[1];
+  EXPECT_EQ(1024, entry.length);
+  EXPECT_EQ(100, entry.count);
+  EXPECT_NEAR(1.0, entry.seconds, 1e-6);
+  EXPECT_EQ(0.1, entry.max_error);
+  EXPECT_LE(1e-6, entry.Percentile(50));
+  EXPECT_GT(2e-6, entry.Percentile(50));
+  EXPECT_LE(1e-3, entry.Percentile(99));
+  EXPECT_GT(2e-3, entry.Percentile(99));
+  EXPECT_EQ(0.1, entry.Percentile(100));
+
+  std::ostringstream oss;
+  MultStats::Dump(oss);
+  EXPECT_NE(std::string::npos, oss.str().find("1024"));
+  MultStats::Reset();
+  EXPECT_TRUE(MultStats::Snapshot().empty());
+}
+
+TEST(MultStatsTest, Natural) {
+  MultStats::Reset();
+  MultStats::setEnabled(true);
+  std::vector<uint64> a(100, ~0ULL), b(100, ~0ULL), c(256);
+  Natural::Mult(a.data(), a.size(), b.data(), b.size(), c.size(), c.data());
+  MultStats::setEnabled(false);
+  Natural::Mult(a.data(), a.size(), b.data(), b.size(), c.size(), c.data());
+
+  std::vector<MultStats::Entry> entries = MultStats::Snapshot();
+  ASSERT_EQ(1U, entries.size());
+  // Each limb is split into 4 doubles.
+  EXPECT_EQ(4 * 256, entries[0].length);
+  EXPECT_EQ(1, entries[0].count);
+  EXPECT_LT(0, entries[0].max_error);
+  MultStats::Reset();
+}
+
+}  // namespace number
+}  // namespace ppi
@@ -3,6 +3,7 @@
 #include <glog/logging.h>
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <ostream>
 
@@ -10,16 +11,26 @@
 #include "base/base.h"
 #include "fmt/fmt.h"
 #include "fmt/rft.h"
+#include "number/mult_stats.h"
 
 namespace ppi {
 namespace number {
 
 namespace {
 
-double* g_workarea[2];
+// Each thread keeps its own work areas, so that multiplications can run
+// concurrently.
+struct WorkAreas {
+  ~WorkAreas() {
+    for (double* area : areas)
+      base::Allocator::Deallocate(area);
+  }
+  double* areas[2]{};
+};
+thread_local WorkAreas g_workarea;
 
 double* WorkArea(int index, int64 size) {
-  double*& workarea = g_workarea[index];
+  double*& workarea = g_workarea.areas[index];
   if (base::Allocator::GetSize(workarea) < size) {
     if (workarea)
       base::Allocator::Deallocate(workarea);
@@ -33,6 +44,9 @@ constexpr int kMaskBitSize = 16;
 constexpr uint64 kMask = (1ULL << kMaskBitSize) - 1;
 constexpr uint64 kShortBase = 1ULL << 32;
 constexpr uint64 kHalfMask = kShortBase - 1;
+// Transforms of at least this number of doubles run in parallel, if a
+// thread pool is set.
+constexpr int64 kMinParallelTransform = 1 << 18;
 
 int64 LeadingZeros(uint64 x) {
   if (x == 0)
@@ -62,6 +76,53 @@ int64 LeadingZeros(uint64 x) {
   return n - (x >> 63);
 }
 
+// Computes a * b.  Returns the lower word and stores the upper word in hi.
+inline uint64 MultWord(const uint64 a, const uint64 b, uint64* hi) {
+#ifdef UINT128
+  const uint128 ab = static_cast<uint128>(a) * b;
+  *hi = static_cast<uint64>(ab >> 64);
+  return static_cast<uint64>(ab);
+#else
+  const uint64 al = a & kHalfMask;
+  const uint64 ah = a >> 32;
+  const uint64 bl = b & kHalfMask;
+  const uint64 bh = b >> 32;
+  const uint64 c00 = al * bl;
+  const uint64 c01 = al * bh;
+  const uint64 c10 = ah * bl;
+  const uint64 mid = (c00 >> 32) + (c01 & kHalfMask) + (c10 & kHalfMask);
+  *hi = ah * bh + (c01 >> 32) + (c10 >> 32) + (mid >> 32);
+  return (mid << 32) | (c00 & kHalfMask);
+#endif  // UINT128
+}
+
+constexpr uint64 kMersenne61 = (1ULL << 61) - 1;
+
+// Computes x + y in modulo 2^64-1.
+inline uint64 AddMod64(const uint64 x, const uint64 y) {
+  const uint64 s = x + y;
+  return s + (s < x);
+}
+
+// Reduces |x| in modulo 2^61-1.
+inline uint64 Reduce61(uint64 x) {
+  x = (x & kMersenne61) + (x >> 61);
+  return (x >= kMersenne61) ? x - kMersenne61 : x;
+}
+
+// Computes a[n] in modulo 2^64-1 and 2^61-1.  2^64 is 1 and 8 in each
+// modulus, respectively.
+void Residues(const uint64* a, const int64 n, uint64* r64, uint64* r61) {
+  uint64 s64 = 0;
+  uint64 s61 = 0;
+  for (int64 i = n - 1; i >= 0; --i) {
+    s64 = AddMod64(s64, a[i]);
+    s61 = Reduce61(Reduce61(s61 << 3) + Reduce61(a[i]));
+  }
+  *r64 = (s64 == ~0ULL) ? 0 : s64;
+  *r61 = s61;
+}
+
 // Core part of Div routines to compute an[3] / bn, assuming an[2] < bn.
 // Returns the quotient, and stores the "normalized" reminder in cn (if not
 // null).
@@ -77,43 +138,35 @@ inline uint64 DivCore(const uint64* an,
   DCHECK_LT(an[0], kShortBase);
   DCHECK_LT(an[1], kShortBase);
 
+  // Each digit of the quotient is estimated from the leading 32 bits of the
+  // divisor, and is over by at most 2.  |rhat| checks the estimate without
+  // overflows, while it is less than kShortBase.
+  const uint64 bn = bn1 * kShortBase + bn0;
   uint64 rem = an[2];
-  uint64 q1 = rem / bn1;
-  if (q1 >= kShortBase) {
-    q1 = kShortBase - 1;
-  }
-  rem = (rem - q1 * bn1) * kShortBase + an[1];
-  if (rem < q1 * bn0) {
-    --q1;
-    rem += bn1 * kShortBase;
-    if (rem < q1 * bn0) {
-      --q1;
-      rem += bn1 * kShortBase;
-    }
-  }
-  rem -= q1 * bn0;
-
-  uint64 q0 = rem / bn1;
-  if (q0 >= kShortBase) {
-    q0 = kShortBase - 1;
-  }
-  rem = (rem - q0 * bn1) * kShortBase + an[0];
-  if (rem < q0 * bn0) {
-    --q0;
-    rem += bn1 * kShortBase;
-    if (rem < q0 * bn0) {
-      --q0;
-      rem += bn1 * kShortBase;
+  uint64 q[2];
+  for (int i = 1; i >= 0; --i) {
+    uint64 qhat = rem / bn1;
+    uint64 rhat = rem - qhat * bn1;
+    while (qhat >= kShortBase || qhat * bn0 > rhat * kShortBase + an[i]) {
+      --qhat;
+      rhat += bn1;
+      if (rhat >= kShortBase)
+        break;
     }
+    // The remainder is less than |bn|, and the wrap around is harmless.
+    rem = rem * kShortBase + an[i] - qhat * bn;
+    q[i] = qhat;
   }
 
   if (cn)
-    *cn = rem - q0 * bn0;
-  return q1 * kShortBase + q0;
+    *cn = rem;
+  return q[1] * kShortBase + q[0];
 }
 
 }  // namespace
 
+std::atomic<base::ThreadPool*> Natural::thread_pool_(nullptr);
+
 uint64 Natural::Add(const uint64* a,
                     const uint64* b,
                     const int64 n,
@@ -183,23 +236,31 @@ double Natural::MultFmt(const uint64* a,
                         const int64 nb,
                         const int64 nc,
                         uint64* c) {
+  using Clock = std::chrono::steady_clock;
+  const bool stats = MultStats::enabled();
+  Clock::time_point start;
+  if (stats)
+    start = Clock::now();
+
   const int64 n = nc;
   const int64 nd = n * 4;
   double* da = WorkArea(0, nd);
   double* db = nullptr;
 
   fmt::Rft rft(nd);
+  base::ThreadPool* pool =
+      (nd >= kMinParallelTransform) ? thread_pool_.load() : nullptr;
 
   // Split uint64[na] -> double[4n]
   Split4(a, na, n, da);
-  rft.Transform(fmt::Direction::Forward, da);
+  rft.Transform(fmt::Direction::Forward, da, pool);
 
   if (a == b) {
     db = da;
   } else {
     db = WorkArea(1, 4 * n);
     Split4(b, nb, n, db);
-    rft.Transform(fmt::Direction::Forward, db);
+    rft.Transform(fmt::Direction::Forward, db, pool);
   }
 
   da[0] *= db[0];
@@ -211,10 +272,15 @@ double Natural::MultFmt(const uint64* a,
     da[2 * i + 1] = ar * bi + ai * br;
   }
 
-  rft.Transform(fmt::Direction::Backward, da);
+  rft.Transform(fmt::Direction::Backward, da, pool);
 
   // Gather Complex[4n] -> uint64[n]
-  return Gather4(da, n, c);
+  const double err = Gather4(da, n, c);
+  if (stats) {
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+    MultStats::Record(nd, elapsed.count(), err);
+  }
+  return err;
 }
 
 uint64 Natural::Mult(const uint64* a,
@@ -259,9 +325,71 @@ uint64 Natural::Mult(const uint64* a,
   return carry;
 }
 
+bool Natural::CheckMult(const uint64* a,
+                        const int64 na,
+                        const uint64* b,
+                        const int64 nb,
+                        const uint64* c,
+                        const int64 nc) {
+  uint64 a64, a61, b64, b61, c64, c61;
+  Residues(a, na, &a64, &a61);
+  Residues(b, nb, &b64, &b61);
+  Residues(c, nc, &c64, &c61);
+
+  uint64 hi;
+  uint64 lo = MultWord(a64, b64, &hi);
+  uint64 ab64 = AddMod64(lo, hi);
+  if (ab64 == ~0ULL)
+    ab64 = 0;
+  // a61 * b61 < 2^122, and hi < 2^58.
+  lo = MultWord(a61, b61, &hi);
+  const uint64 ab61 = Reduce61((lo & kMersenne61) + (lo >> 61) + (hi << 3));
+  return ab64 == c64 && ab61 == c61;
+}
+
+uint64 Natural::MultAdd(const uint64* a,
+                        const uint64 b,
+                        const int64 n,
+                        uint64* c) {
+  uint64 carry = 0;
+  for (int64 i = 0; i < n; ++i) {
+    uint64 hi;
+    uint64 lo = MultWord(a[i], b, &hi) + carry;
+    hi += (lo < carry) ? 1 : 0;
+    c[i] += lo;
+    hi += (c[i] < lo) ? 1 : 0;
+    carry = hi;
+  }
+  return carry;
+}
+
+uint64 Natural::MultSubtract(const uint64* a,
+                             const uint64 b,
+                             const int64 n,
+                             uint64* c) {
+  uint64 borrow = 0;
+  for (int64 i = 0; i < n; ++i) {
+    uint64 hi;
+    uint64 lo = MultWord(a[i], b, &hi) + borrow;
+    hi += (lo < borrow) ? 1 : 0;
+    const uint64 ci = c[i];
+    c[i] = ci - lo;
+    hi += (ci < lo) ? 1 : 0;
+    borrow = hi;
+  }
+  return borrow;
+}
+
 uint64 Natural::Div(const uint64* a, const uint64 b, uint64* c) {
   DCHECK_LT(a[1], b);
 
+#ifdef UINT128
+  uint64 rem;
+  uint64 q = Divisor(b).Div(a[1], a[0], &rem);
+  if (c)
+    *c = rem;
+  return q;
+#else
   // Normalize numbers to set divisor to have the MSB.
   int64 shift = LeadingZeros(b);
   uint64 bn = b << shift;
@@ -280,9 +408,19 @@ uint64 Natural::Div(const uint64* a, const uint64 b, uint64* c) {
   if (c)
     *c >>= shift;
   return q;
+#endif  // UINT128
 }
 
 uint64 Natural::Div(const uint64* a, const uint64 b, const int64 n, uint64* c) {
+#ifdef UINT128
+  // The reciprocal of |b| is computed once, and each limb is divided with
+  // multiplications only.
+  const Divisor divisor(b);
+  uint64 rem = 0;
+  for (int64 i = n - 1; i >= 0; --i)
+    c[i] = divisor.Div(rem, a[i], &rem);
+  return rem;
+#else
   // Normalize numbers to set the divisor to have the MSB.
   const int64 shift = LeadingZeros(b);
   const uint64 bn = b << shift;
@@ -292,25 +430,26 @@ uint64 Natural::Div(const uint64* a, const uint64 b, const int64 n, uint64* c) {
   uint64 rem = (a[n - 1] % b) << shift;
   c[n - 1] = a[n - 1] / b;
   for (int64 i = n - 2; i >= 0; --i) {
-    uint64 an1 = rem + (a[i] >> (64 - shift));
+    uint64 an1 = rem;
+    if (shift)
+      an1 += a[i] >> (64 - shift);
     uint64 an0 = a[i] << shift;
     uint64 an[4]{an0 & kHalfMask, an0 >> 32, an1};
     c[i] = DivCore(an, bn0, bn1, &rem);
   }
   return rem >> shift;
+#endif  // UINT128
 }
 
 uint64 Natural::Div(const uint64 a, const uint64 b, const int64 n, uint64* c) {
   DCHECK_LT(a, b);
 
 #ifdef UINT128
-  uint128 r(a);
-  for (int64 i = n - 1; i >= 0; --i) {
-    r <<= 64;
-    c[i] = r / b;
-    r %= b;
-  }
-  return static_cast<uint64>(r);
+  const Divisor divisor(b);
+  uint64 rem = a;
+  for (int64 i = n - 1; i >= 0; --i)
+    c[i] = divisor.Div(rem, 0, &rem);
+  return rem;
 #else
   // Normalize numbers to set divisor to have the MSB.
   const int64 shift = LeadingZeros(b);
@@ -327,6 +466,14 @@ uint64 Natural::Div(const uint64 a, const uint64 b, const int64 n, uint64* c) {
 #endif  // UINT128
 }
 
+Divisor::Divisor(const uint64 d) : d_(d), shift_(LeadingZeros(d)), v_(0) {
+  DCHECK_NE(0ULL, d);
+  dn_ = d << shift_;
+#ifdef UINT128
+  v_ = static_cast<uint64>(((static_cast<uint128>(~dn_) << 64) | ~0ULL) / dn_);
+#endif
+}
+
 void Natural::Split4(const uint64* a,
                      const int64 na,
                      const int64 n,
@@ -366,9 +513,6 @@ double Natural::Gather4(double* ca, const int64 n, uint64* a) {
     carry = std::floor(d / kDoubleBase);
     ca[i] = d - carry * kDoubleBase;
   }
-  // Because of cyclic convolution, we may have a carry from
-  // MSD to LSD.
-  ca[0] += carry;
 
   // Normalize & re-alignment
   for (int64 i = 0; i < n; ++i) {
@@ -381,6 +525,15 @@ double Natural::Gather4(double* ca, const int64 n, uint64* a) {
            ia0;
   }
 
+  // Because of cyclic convolution, we may have a carry from MSD to LSD.
+  // It is 0 unless the product overflows n limbs.  2^(64n) = 1 in modulo
+  // 2^(64n)-1, so carries and borrows go around again.
+  int64 wrap = static_cast<int64>(carry);
+  while (wrap > 0)
+    wrap = Add(a, wrap, n, a);
+  while (wrap < 0)
+    wrap = -static_cast<int64>(Subtract(a, -wrap, n, a));
+
   return err;
 }
 
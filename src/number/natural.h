@@ -1,6 +1,9 @@
 #pragma once
 
+#include <atomic>
+
 #include "base/base.h"
+#include "base/thread_pool.h"
 
 namespace ppi {
 namespace number {
@@ -16,6 +19,10 @@ class Natural {
                          const int64 n,
                          uint64* c);
   static uint64 Subtract(const uint64* a, uint64 b, const int64 n, uint64* c);
+  // Computes c[nc] = a[na] * b[nb] in modulo 2^(64nc)-1, where nc is a power
+  // of 2 and not less than na and nb.  It is the product itself if
+  // na + nb <= nc.  Otherwise, the leading limbs wrap around onto the
+  // trailing ones, and the limbs in [na+nb-nc, nc) are left as they are.
   static double Mult(const uint64* a,
                      const int64 na,
                      const uint64* b,
@@ -23,19 +30,41 @@ class Natural {
                      const int64 nc,
                      uint64* c);
   static uint64 Mult(const uint64* a, const uint64 b, const int64 n, uint64* c);
+  // Returns whether c[nc] = a[na] * b[nb] holds in modulo 2^64-1 and in
+  // modulo 2^61-1.  It costs O(na + nb + nc), and is a cheap check of
+  // products with FFT.
+  static bool CheckMult(const uint64* a,
+                        const int64 na,
+                        const uint64* b,
+                        const int64 nb,
+                        const uint64* c,
+                        const int64 nc);
+  // Computes c[n] += a[n] * b, and returns the carry.
+  static uint64 MultAdd(const uint64* a,
+                        const uint64 b,
+                        const int64 n,
+                        uint64* c);
+  // Computes c[n] -= a[n] * b, and returns the borrow.
+  static uint64 MultSubtract(const uint64* a,
+                             const uint64 b,
+                             const int64 n,
+                             uint64* c);
 
   // Computes a[2] / b, assuming a[1] < b.  It means the quotient is storable in
   // uint64.
   // Returns the quotient and stores the remainder in c.
   static uint64 Div(const uint64* a, const uint64 b, uint64* c);
-  // Computes a[n] / b, assuming a[n-1] < b.  It means the quotient is storable
-  // in uint64.
-  // Returns the quotient and stores the remainder in c.
+  // Computes c[n] = a[n] / b, and returns the remainder.
+  // |a| and |c| can be the same array.
   static uint64 Div(const uint64* a, const uint64 b, const int64 n, uint64* c);
   // Computes (a << (n * 64)) / b, assuming a < b.
   // Stores the quotient into c, and returns the remainder.
   static uint64 Div(const uint64 a, const uint64 b, const int64 n, uint64* c);
 
+  // Sets a thread pool, in which transforms of large multiplications run
+  // in parallel.  It has to be alive while it is set.  Null disables it.
+  static void setThreadPool(base::ThreadPool* pool) { thread_pool_ = pool; }
+
  protected:
   static double MultFmt(const uint64* a,
                         const int64 na,
@@ -48,7 +77,59 @@ class Natural {
                      const int64 n,
                      double* ca);
   static double Gather4(double* ca, const int64 n, uint64* a);
+
+  static std::atomic<base::ThreadPool*> thread_pool_;
 };
 
+// Divisor keeps a word divisor with its precomputed reciprocal, so that
+// dividing many words by the same divisor needs only multiplications.
+// Algorithm is described in "Improved division by invariant integers" by
+// N. Moller and T. Granlund.
+class Divisor {
+ public:
+  explicit Divisor(const uint64 d);
+
+  // Computes (u1 * 2^64 + u0) / d, assuming u1 < d.
+  // Returns the quotient and stores the remainder in r.
+  uint64 Div(const uint64 u1, const uint64 u0, uint64* r) const;
+
+  uint64 value() const { return d_; }
+
+ private:
+  uint64 d_;
+  int64 shift_;
+  // Normalized divisor, which has the MSB, and its reciprocal
+  // floor((2^128 - 1) / dn_) - 2^64.
+  uint64 dn_;
+  uint64 v_;
+};
+
+inline uint64 Divisor::Div(const uint64 u1, const uint64 u0, uint64* r) const {
+#ifdef UINT128
+  // (u0 >> 1) >> (63 - shift_) avoids shifting 64 bits when shift_ is 0.
+  const uint64 n1 = (u1 << shift_) | ((u0 >> 1) >> (63 - shift_));
+  const uint64 n0 = u0 << shift_;
+
+  uint128 q = static_cast<uint128>(v_) * n1;
+  q += (static_cast<uint128>(n1 + 1) << 64) | n0;
+  uint64 q1 = static_cast<uint64>(q >> 64);
+  const uint64 q0 = static_cast<uint64>(q);
+  uint64 rem = n0 - q1 * dn_;
+  if (rem > q0) {
+    --q1;
+    rem += dn_;
+  }
+  if (rem >= dn_) {
+    ++q1;
+    rem -= dn_;
+  }
+  *r = rem >> shift_;
+  return q1;
+#else
+  const uint64 a[]{u0, u1};
+  return Natural::Div(a, d_, r);
+#endif  // UINT128
+}
+
 }  // namespace number
 }  // namespace ppi
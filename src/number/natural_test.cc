@@ -3,6 +3,7 @@
 #include <gtest/gtest.h>
 
 #include <random>
+#include <vector>
 
 #include "base/base.h"
 
@@ -97,6 +98,119 @@ TEST(NaturalTest, Div2By1) {
   }
 }
 
+TEST(NaturalTest, DivNBy1) {
+  constexpr int64 kSize = 50;
+  const uint64 kDivisors[] = {
+      1, 3, 25, 239 * 239, 10000000000000000000ULL, (1ULL << 63) - 1,
+      1ULL << 63, ~0ULL,
+  };
+
+  std::mt19937_64 mt(19937);  // Fixed seed
+  uint64 a[kSize], q[kSize], p[kSize];
+  for (uint64 b : kDivisors) {
+    for (int64 i = 0; i < kSize; ++i)
+      a[i] = mt();
+
+    uint64 r = Natural::Div(a, b, kSize, q);
+    EXPECT_LT(r, b);
+    // Check a == q * b + r
+    uint64 carry = Natural::Mult(q, b, kSize, p);
+    EXPECT_EQ(0ULL, carry) << "for b = " << b;
+    carry = Natural::Add(p, r, kSize, p);
+    EXPECT_EQ(0ULL, carry) << "for b = " << b;
+    for (int64 i = 0; i < kSize; ++i)
+      ASSERT_EQ(a[i], p[i]) << "for b = " << b << ", i = " << i;
+
+    // In-place division gives the same result.
+    EXPECT_EQ(r, Natural::Div(a, b, kSize, a));
+    for (int64 i = 0; i < kSize; ++i)
+      ASSERT_EQ(q[i], a[i]) << "for b = " << b << ", i = " << i;
+  }
+}
+
+TEST(NaturalTest, DivWordBy1) {
+  constexpr int64 kSize = 4;
+  // 1 / 3 = 0.5555...
+  uint64 q[kSize];
+  EXPECT_EQ(1ULL, Natural::Div(1, 3, kSize, q));
+  for (int64 i = 0; i < kSize; ++i)
+    EXPECT_EQ(0x5555555555555555ULL, q[i]);
+
+  // 2 / 3 = 0.AAAA...
+  EXPECT_EQ(2ULL, Natural::Div(2, 3, kSize, q));
+  for (int64 i = 0; i < kSize; ++i)
+    EXPECT_EQ(0xAAAAAAAAAAAAAAAAULL, q[i]);
+}
+
+TEST(NaturalTest, Divisor) {
+  const uint64 kDivisors[] = {1, 25, 57121, 1ULL << 63, ~0ULL};
+
+  std::mt19937_64 mt(19937);  // Fixed seed
+  for (uint64 b : kDivisors) {
+    const Divisor divisor(b);
+    EXPECT_EQ(b, divisor.value());
+    for (int64 i = 0; i < 1000; ++i) {
+      uint64 a[]{mt(), mt() % b};
+      uint64 expect_rem;
+      uint64 expect_quot = Natural::Div(a, b, &expect_rem);
+      uint64 rem;
+      EXPECT_EQ(expect_quot, divisor.Div(a[1], a[0], &rem));
+      EXPECT_EQ(expect_rem, rem);
+    }
+  }
+}
+
+TEST(NaturalTest, MultAddAndSubtract) {
+  constexpr int64 kSize = 20;
+  std::mt19937_64 mt(19937);  // Fixed seed
+  uint64 a[kSize], c[kSize], expect[kSize], prod[kSize];
+  for (int64 i = 0; i < kSize; ++i) {
+    a[i] = mt();
+    c[i] = expect[i] = mt();
+  }
+  const uint64 b = mt();
+
+  // c + a * b
+  uint64 prod_carry = Natural::Mult(a, b, kSize, prod);
+  uint64 add_carry = Natural::Add(expect, prod, kSize, expect);
+  uint64 carry = Natural::MultAdd(a, b, kSize, c);
+  EXPECT_EQ(prod_carry + add_carry, carry);
+  for (int64 i = 0; i < kSize; ++i)
+    ASSERT_EQ(expect[i], c[i]) << "for i = " << i;
+
+  // (c + a * b) - a * b
+  uint64 borrow = Natural::MultSubtract(a, b, kSize, c);
+  EXPECT_EQ(carry, borrow);
+  Natural::Subtract(expect, prod, kSize, expect);
+  for (int64 i = 0; i < kSize; ++i)
+    ASSERT_EQ(expect[i], c[i]) << "for i = " << i;
+}
+
+TEST(NaturalTest, CheckMult) {
+  std::mt19937_64 rng(7);
+  const int64 na = 300, nb = 200, nc = 512;
+  std::vector<uint64> a(na), b(nb), c(nc);
+  for (auto& x : a)
+    x = rng();
+  for (auto& x : b)
+    x = rng();
+  // Residues of all ~0 limbs are 0 in modulo 2^64-1.
+  a[0] = a[1] = ~0ULL;
+
+  Natural::Mult(a.data(), na, b.data(), nb, nc, c.data());
+  EXPECT_TRUE(Natural::CheckMult(a.data(), na, b.data(), nb, c.data(), nc));
+
+  // An error in a 16-bit element of FFT.
+  c[123] += 1ULL << 48;
+  EXPECT_FALSE(Natural::CheckMult(a.data(), na, b.data(), nb, c.data(), nc));
+  c[123] -= 1ULL << 48;
+
+  // Errors which cancel in modulo 2^64-1.
+  ++c[10];
+  --c[11];
+  EXPECT_FALSE(Natural::CheckMult(a.data(), na, b.data(), nb, c.data(), nc));
+}
+
 TEST(NaturalTest, Split) {
   uint64 a = 0x1234567890abcdefULL;
   double b[4];
@@ -1,18 +1,30 @@
 #include "number/real.h"
 
+#include <fcntl.h>
 #include <glog/logging.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <cinttypes>
 #include <cmath>
 #include <cstdio>
 #include <cstring>
-#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <ostream>
+#include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "base/base.h"
+#include "base/thread_pool.h"
 #include "number/natural.h"
 
 namespace ppi {
@@ -23,6 +35,493 @@ namespace {
 const double kPow2_64 = 18446744073709551616.0;  // 2^64
 const double kPow2_m64 = 1.0 / kPow2_64;
 
+// Copies the leading |n| limbs of |a| into |b|, and sets its precision |n|.
+void Truncate(const Real& a, int64 n, Real* b) {
+  const int64 skip = std::max<int64>(a.size() - n, 0);
+  b->reset(a.size() - skip);
+  std::copy(a.data() + skip, a.data() + a.size(), b->data());
+  b->setExponent(a.exponent() + skip);
+  b->setPrecision(n);
+}
+
+// Compares |a| and |b|, and returns a negative value, 0, or a positive
+// value if a < b, a == b, or a > b, respectively.
+int CompareValues(const Real& a, const Real& b) {
+  if (a.size() == 0 || b.size() == 0)
+    return (a.size() > 0) - (b.size() > 0);
+
+  const int64 a_lead = a.size() + a.exponent();
+  const int64 b_lead = b.size() + b.exponent();
+  if (a_lead != b_lead)
+    return (a_lead < b_lead) ? -1 : 1;
+
+  int64 ia = a.size() - 1, ib = b.size() - 1;
+  for (; ia >= 0 && ib >= 0; --ia, --ib) {
+    if (a[ia] != b[ib])
+      return (a[ia] < b[ib]) ? -1 : 1;
+  }
+  return (ia >= 0) - (ib >= 0);
+}
+
+// Returns the limb of |a| for (2^64)^|i|, or 0 if it is out of |a|.
+inline uint64 LimbAt(const Real& a, const int64 i) {
+  const int64 j = i - a.exponent();
+  return (j >= 0 && j < a.size()) ? a[j] : 0;
+}
+
+// Returns the carry into the limb for (2^64)^|low| in a+b.
+uint64 CarryUnder(const Real& a, const Real& b, const int64 low) {
+  const int64 bottom = std::min(a.exponent(), b.exponent());
+  for (int64 i = low - 1; i >= bottom; --i) {
+    const uint64 x = LimbAt(a, i);
+    const uint64 s = x + LimbAt(b, i);
+    if (s < x)
+      return 1;
+    if (s != ~0ULL)
+      return 0;
+  }
+  return 0;
+}
+
+// Returns the borrow from the limb for (2^64)^|low| in a-b.
+uint64 BorrowUnder(const Real& a, const Real& b, const int64 low) {
+  const int64 bottom = std::min(a.exponent(), b.exponent());
+  for (int64 i = low - 1; i >= bottom; --i) {
+    const uint64 x = LimbAt(a, i);
+    const uint64 y = LimbAt(b, i);
+    if (x != y)
+      return (x < y) ? 1 : 0;
+  }
+  return 0;
+}
+
+// Returns the least power of 2, which is not less than |n|.
+int64 MinPow2(const int64 n) {
+  int64 p = 1;
+  while (p < n)
+    p *= 2;
+  return p;
+}
+
+// Returns precisions of Newton iterations to get |length| limbs, in the
+// increasing order.  Each iteration doubles the accuracy, and the first
+// one starts from an approximation in a double.  A guard limb is added to
+// each, because the leading limb can have only a few bits.
+std::vector<int64> NewtonPrecisions(int64 length) {
+  std::vector<int64> precisions;
+  for (int64 k = length + 1;; k = (k + 1) / 2 + 1) {
+    precisions.push_back(k);
+    if (k <= 3)
+      break;
+  }
+  if (precisions.back() > 2)
+    precisions.push_back(2);
+  std::reverse(precisions.begin(), precisions.end());
+  return precisions;
+}
+
+constexpr uint64 kDecBase = 10000000000000000000ULL;
+// The number of hexadecimal limbs per a decimal limb, log(10^19)/log(2^64)
+// = 0.98619740317..., and its inverse.  They are rounded up, so that limb
+// counts from them never fall short, even for 10^12 limbs.
+constexpr double kHexLimbsPerDec = 0.9861975;
+constexpr double kDecLimbsPerHex = 1.0139958;
+// Guard limbs for truncation errors in each level of the radix conversion.
+constexpr int64 kConvertGuardLimbs = 2;
+// Fractions of up to this number of decimal limbs are converted with
+// multiplications by 10^19, which cost O(n^2).
+constexpr int64 kMinConvertSplit = 128;
+// Halves of at least this number of decimal limbs are converted in
+// parallel.
+constexpr int64 kMinParallelConvert = 2048;
+// In ordered conversions, larger fractions are converted chunk by chunk
+// from the leading one, so that only a chunk waits for its leading blocks
+// in OrderedBlocks.
+constexpr int64 kMaxOrderedParallelConvert = 1 << 18;
+
+// Powers of 10^19 used to split the conversion.
+using DecPowers = std::map<int64, Integer>;
+
+// Collects sizes of the leading halves, which split the conversion of |n|
+// decimal limbs, into |powers|.
+void CollectSplits(const int64 n,
+                   std::set<int64>* visited,
+                   DecPowers* powers) {
+  if (n <= kMinConvertSplit || !visited->insert(n).second)
+    return;
+  (*powers)[n / 2];
+  CollectSplits(n / 2, visited, powers);
+  CollectSplits(n - n / 2, visited, powers);
+}
+
+// Computes the collected powers of 10^19.
+void ComputeDecPowers(DecPowers* powers, base::ThreadPool* pool) {
+  std::vector<std::function<void()>> tasks;
+  for (auto& power : *powers) {
+    const int64 e = power.first;
+    Integer* p = &power.second;
+    tasks.push_back([e, p] { Integer::Power(kDecBase, e, p); });
+  }
+  if (pool) {
+    pool->Run(tasks);
+  } else {
+    for (auto& task : tasks)
+      task();
+  }
+}
+
+// Copies leading |n| limbs of f/(2^64)^m into |top|, and returns the number
+// of the limbs.
+int64 LeadingLimbs(const Integer& f, const int64 m, int64 n, Integer* top) {
+  n = std::min(n, m);
+  top->reset(n);
+  for (int64 i = 0; i < n; ++i) {
+    const int64 j = m - n + i;
+    (*top)[i] = (j < f.size()) ? f[j] : 0;
+  }
+  return n;
+}
+
+// Receives |n| decimal limbs from the |offset|-th limb under the point, in
+// the order from the leading one.  A negative offset is for the integral
+// part.
+using DecimalBlock =
+    std::function<void(int64 offset, const uint64* limbs, int64 n)>;
+
+// Converts a fraction f/(2^64)^m into |n| decimal limbs, which are passed
+// to |emit| with offsets from |offset|.  |f| is released on the way.
+// The leading half is the conversion of f in a lower precision, and the
+// trailing half is the one of frac(f*10^(19h)).  Both halves are converted
+// recursively, in a scaled remainder tree.
+// If |ordered| is true, blocks are expected to be passed in the order of
+// offsets, and halves of large fractions are converted one after another.
+void FractionToDecimal(Integer* f,
+                       const int64 m,
+                       const int64 n,
+                       const int64 offset,
+                       const DecPowers& powers,
+                       base::ThreadPool* pool,
+                       const bool ordered,
+                       const DecimalBlock& emit) {
+  if (n <= kMinConvertSplit) {
+    Integer frac;
+    const int64 len = LeadingLimbs(*f, m, Real::HexLimbsForDecimal(n), &frac);
+    f->clear();
+    uint64 block[kMinConvertSplit];
+    for (int64 i = 0; i < n; ++i)
+      block[i] = Natural::Mult(frac.data(), kDecBase, len, frac.data());
+    emit(offset, block, n);
+    return;
+  }
+
+  const int64 hi = n / 2;
+  const int64 lo = n - hi;
+  Integer f_hi, f_lo;
+  const int64 m_hi = LeadingLimbs(*f, m, Real::HexLimbsForDecimal(hi), &f_hi);
+
+  // The integral part of f*10^(19hi) is not needed.  It wraps around onto
+  // limbs under the precision in a middle product.
+  const Integer& power = powers.at(hi);
+  const int64 m_lo = std::min(m, Real::HexLimbsForDecimal(lo));
+  const int64 prod_size = f->size() + power.size();
+  const int64 nc = std::min(MinPow2(std::max(m, power.size() + m_lo + 1)),
+                            MinPow2(prod_size));
+  Integer::MultMiddle(*f, power, nc, f);
+  LeadingLimbs(*f, m, m_lo, &f_lo);
+  f->clear();
+
+  std::vector<std::function<void()>> tasks;
+  tasks.push_back([&] {
+    FractionToDecimal(&f_hi, m_hi, hi, offset, powers, pool, ordered, emit);
+  });
+  tasks.push_back([&] {
+    FractionToDecimal(&f_lo, m_lo, lo, offset + hi, powers, pool, ordered,
+                      emit);
+  });
+  if (pool && n >= kMinParallelConvert &&
+      (!ordered || n <= kMaxOrderedParallelConvert)) {
+    pool->Run(tasks);
+  } else {
+    for (auto& task : tasks)
+      task();
+  }
+}
+
+// Converts |a| into decimal limbs, with |precision| limbs under the point.
+// The integral part is passed to |emit| first, in a block.  See
+// FractionToDecimal() for |ordered|.
+void ConvertHexToDecimal(const Real& a,
+                         const int64 precision,
+                         const int64 num_threads,
+                         const bool ordered,
+                         const DecimalBlock& emit) {
+  std::unique_ptr<base::ThreadPool> pool;
+  if (num_threads > 1)
+    pool.reset(new base::ThreadPool(num_threads));
+  // Products near the root of the remainder tree run their transforms in
+  // parallel too.
+  Natural::setThreadPool(pool.get());
+
+  // The integral part x is converted as a fraction (2x+1)/(2*10^(19d)), so
+  // that its d decimal limbs are exact.
+  Integer integral;
+  const int64 integral_size = std::max<int64>(a.size() + a.exponent(), 0);
+  integral.reset(integral_size);
+  for (int64 i = 0; i < integral_size; ++i)
+    integral[i] = LimbAt(a, i);
+  Real scaled;
+  int64 d = 0;
+  if (integral_size > 1 || (integral_size == 1 && integral[0] >= kDecBase)) {
+    d = static_cast<int64>(std::ceil(integral_size * kDecLimbsPerHex)) + 1;
+    Real numer, denom;
+    Integer::Mult(integral, 2, &numer);
+    Integer::Add(numer, Integer(1), &numer);
+    numer.setPrecision(numer.size());
+    Integer::Power(kDecBase, d, &denom);
+    Integer::Mult(denom, 2, &denom);
+    denom.setPrecision(denom.size());
+    scaled.setPrecision(Real::HexLimbsForDecimal(d) + 1);
+    Real::Div(numer, denom, &scaled);
+  }
+
+  DecPowers powers;
+  std::set<int64> visited;
+  CollectSplits(precision, &visited, &powers);
+  CollectSplits(d, &visited, &powers);
+  ComputeDecPowers(&powers, pool.get());
+
+  std::vector<uint64> integral_dec(1, (integral_size == 1) ? integral[0] : 0);
+  if (d > 0) {
+    const int64 m = Real::HexLimbsForDecimal(d) + 1;
+    Integer frac;
+    frac.reset(m);
+    for (int64 i = 0; i < m; ++i)
+      frac[i] = LimbAt(scaled, i - m);
+    integral_dec.resize(d);
+    FractionToDecimal(&frac, m, d, 0, powers, pool.get(), false,
+                      [&integral_dec](int64 offset, const uint64* limbs,
+                                      int64 n) {
+                        std::copy(limbs, limbs + n,
+                                  integral_dec.begin() + offset);
+                      });
+    // Remove leading zeros.
+    int64 zeros = 0;
+    while (zeros + 1 < d && integral_dec[zeros] == 0)
+      ++zeros;
+    integral_dec.erase(integral_dec.begin(), integral_dec.begin() + zeros);
+  }
+  emit(-static_cast<int64>(integral_dec.size()), integral_dec.data(),
+       integral_dec.size());
+
+  // Fractional part
+  const int64 m = Real::HexLimbsForDecimal(precision);
+  Integer frac;
+  frac.reset(m);
+  for (int64 i = 0; i < m; ++i)
+    frac[i] = LimbAt(a, i - m);
+  FractionToDecimal(&frac, m, precision, 0, powers, pool.get(), ordered,
+                    emit);
+  Natural::setThreadPool(nullptr);
+}
+
+// Passes blocks to a sink in the order of offsets.  Blocks which come
+// early are kept until their preceding blocks come.  The sink is called
+// out of the lock, by one thread at a time, so that other threads keep
+// converting while it writes.
+class OrderedBlocks {
+ public:
+  explicit OrderedBlocks(const Real::DecimalSink& sink)
+      : sink_(sink), next_(0), draining_(false) {}
+
+  void Put(int64 offset, const uint64* limbs, int64 n) {
+    // The integral part comes before any other block.
+    if (offset < 0) {
+      sink_(limbs, n);
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (offset != next_ || draining_) {
+        pending_[offset].assign(limbs, limbs + n);
+        return;
+      }
+      draining_ = true;
+    }
+
+    // This thread passes its block, and the following pending ones.
+    sink_(limbs, n);
+    std::vector<uint64> block;
+    std::unique_lock<std::mutex> lock(mutex_);
+    next_ += n;
+    for (auto it = pending_.begin();
+         it != pending_.end() && it->first == next_;
+         it = pending_.begin()) {
+      block.swap(it->second);
+      pending_.erase(it);
+      lock.unlock();
+      sink_(block.data(), block.size());
+      lock.lock();
+      next_ += block.size();
+    }
+    draining_ = false;
+  }
+
+ private:
+  const Real::DecimalSink& sink_;
+  std::mutex mutex_;
+  int64 next_;
+  bool draining_;
+  std::map<int64, std::vector<uint64>> pending_;
+};
+
+// Reference files have the point in this size from their heads.
+const int64 kMaxReferenceHeader = 4096;
+
+// Digits under the point in a memory-mapped reference file.  The file has
+// a header which ends with the point, e.g. "0." or "pi = 3.\n", and digits
+// follow in lines of a fixed width, or without line breaks.
+class ReferenceDigits {
+ public:
+  explicit ReferenceDigits(const std::string& filename)
+      : data_(nullptr),
+        size_(0),
+        digits_(nullptr),
+        width_(0),
+        separator_(0),
+        num_digits_(0) {
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (ptr != MAP_FAILED) {
+        data_ = static_cast<const char*>(ptr);
+        size_ = st.st_size;
+      }
+    }
+    close(fd);
+    if (data_)
+      Parse();
+  }
+
+  ~ReferenceDigits() {
+    if (data_)
+      munmap(const_cast<char*>(data_), size_);
+  }
+
+  bool ok() const { return digits_ != nullptr; }
+  int64 num_digits() const { return num_digits_; }
+
+  // Copies |n| digits from the |digit|-th one into |out|.
+  void Read(int64 digit, int64 n, char* out) const {
+    while (n > 0) {
+      const int64 k = std::min(n, width_ - digit % width_);
+      std::memcpy(out, digits_ + digit + digit / width_ * separator_, k);
+      out += k;
+      digit += k;
+      n -= k;
+    }
+  }
+
+ private:
+  void Parse() {
+    const char* point = static_cast<const char*>(
+        std::memchr(data_, '.', std::min(size_, kMaxReferenceHeader)));
+    if (!point)
+      return;
+    const char* begin = point + 1;
+    const char* end = data_ + size_;
+    if (begin < end && *begin == '\r')
+      ++begin;
+    if (begin < end && *begin == '\n')
+      ++begin;
+    while (end > begin && std::isspace(end[-1]))
+      --end;
+
+    // The first line tells the width of lines.
+    const char* newline =
+        static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+    if (newline) {
+      width_ = newline - begin;
+      separator_ = 1;
+      if (width_ > 0 && newline[-1] == '\r') {
+        --width_;
+        ++separator_;
+      }
+      if (width_ == 0)
+        return;
+    } else {
+      width_ = std::max<int64>(end - begin, 1);
+    }
+    const int64 line = width_ + separator_;
+    num_digits_ = (end - begin) / line * width_ +
+                  std::min((end - begin) % line, width_);
+    digits_ = begin;
+  }
+
+  const char* data_;
+  int64 size_;
+  const char* digits_;
+  int64 width_;
+  // Size of line breaks, "\n" or "\r\n".
+  int64 separator_;
+  int64 num_digits_;
+};
+
+// Parses |digits| of a limb, 16 hexadecimal or 19 decimal digits.  Returns
+// false if they have other characters.
+bool ParseLimb(const char* digits, const bool hex, uint64* value) {
+  uint64 v = 0;
+  if (hex) {
+    for (int i = 0; i < 16; ++i) {
+      const char c = digits[i];
+      uint64 d;
+      if (c >= '0' && c <= '9')
+        d = c - '0';
+      else if (c >= 'A' && c <= 'F')
+        d = c - 'A' + 10;
+      else if (c >= 'a' && c <= 'f')
+        d = c - 'a' + 10;
+      else
+        return false;
+      v = (v << 4) | d;
+    }
+  } else {
+    for (int i = 0; i < 19; ++i) {
+      const char c = digits[i];
+      if (c < '0' || c > '9')
+        return false;
+      v = v * 10 + (c - '0');
+    }
+  }
+  *value = v;
+  return true;
+}
+
+// Compares |n| leading digits of |limb| with |reference| from the
+// |digit|-th one, and returns the offset of the first mismatched digit, or
+// -1 if they match.
+int64 FindMismatch(const ReferenceDigits& reference,
+                   const uint64 limb,
+                   const int64 digit,
+                   const int64 n,
+                   const bool hex) {
+  char refer[24];
+  reference.Read(digit, n, refer);
+  uint64 value;
+  if (n == (hex ? 16 : 19) && ParseLimb(refer, hex, &value) && value == limb)
+    return -1;
+
+  char buffer[24];
+  std::sprintf(buffer, hex ? "%016" PRIX64 : "%019" PRIu64, limb);
+  for (int64 j = 0; j < n; ++j) {
+    if (buffer[j] != std::toupper(refer[j]))
+      return digit + j;
+  }
+  return -1;
+}
+
 }  // namespace
 
 Real::Real(const Base base) : Integer(base), precision_(0), exponent_(0) {}
@@ -55,6 +554,7 @@ Real::Real(double d, const Base base) : Integer(base) {
     (*this)[0] = static_cast<uint64>((d - lead) * kPow2_64);
     (*this)[1] = lead;
     precision_ = 2;
+    --e;
   }
   exponent_ = e;
 }
@@ -64,46 +564,120 @@ Real::Real(const Real& other)
       precision_(other.precision_),
       exponent_(other.exponent_) {}
 
+Real::Real(Real&& other)
+    : Integer(std::move(other)),
+      precision_(other.precision_),
+      exponent_(other.exponent_) {}
+
 void Real::fitInteger(int64 n) {
   exponent_ = 0;
   precision_ = n;
 }
 
+// The matching limbs and the limb of 1 wrap around onto the trailing limbs,
+// which are out of the precision, in a middle product.  So the transform
+// needs only about n limbs, instead of the full product's.
+// static
+double Real::OneMinusMult(const Real& a,
+                          const Real& b,
+                          const int64 n,
+                          const int64 known,
+                          Real* d,
+                          bool* negative) {
+  const int64 na = a.size();
+  const int64 nb = b.size();
+  const int64 one_pos = -(a.exponent() + b.exponent());
+  const int64 low = one_pos - n;
+  const int64 min_size =
+      std::max({na, nb, na + nb - low + 1, one_pos - known + 1});
+  const int64 nc = MinPow2(min_size);
+
+  if (low > 0 && nc < na + nb) {
+    Integer prod;
+    double err = Integer::MultMiddle(a, b, nc, &prod);
+    auto limb = [&prod](int64 i) { return (i < prod.size()) ? prod[i] : 0; };
+    // Limbs in [nc, one_pos) are all 0 if a*b >= 1, or all ~0 if a*b < 1.
+    const uint64 top = limb(nc - 1);
+    if (top == 0 || top == ~0ULL) {
+      *negative = (top == 0);
+      d->reset(nc - low);
+      for (int64 i = low; i < nc; ++i)
+        (*d)[i - low] = *negative ? limb(i) : ~limb(i);
+      d->setExponent(-n);
+      d->setPrecision(n);
+      d->Normalize();
+      return err;
+    }
+  }
+
+  // Compute the full product, if it is not shorter or a*b is not close to 1.
+  const Real one(1.0);
+  d->setPrecision(n);
+  double err = Mult(a, b, d);
+  *negative = CompareValues(one, *d) < 0;
+  if (*negative)
+    Sub(*d, one, d);
+  else
+    Sub(one, *d, d);
+  return err;
+}
+
 double Real::InverseSqrt(uint64 a, Real* val) {
-  Real tmp;
-  int64 length = val->precision();
+  Real x;
+  x.setPrecision(1);
+  x.resize(1);
+  x[0] = a;
+  x.setExponent(0);
+  return InverseSqrt(x, val);
+}
 
-  // Initialize
-  *val = 1.0 / std::sqrt(a);
+double Real::InverseSqrt(const Real& a, Real* val) {
+  DCHECK(&a != val);
+  CHECK_GT(a.size(), 0);
 
-  double max_error = 0;
-  for (int64 k = 1; k < length;) {
-    k *= 2;
-    tmp.setPrecision(k);
-    double err = Mult(*val, *val, &tmp);
-    max_error = std::max(err, max_error);
-    Mult(tmp, a, &tmp);
+  const int64 length = val->precision();
 
-    // Computing "1 - |tmp|", assuming |tmp| is a bit smaller than 1.
-    for (int64 i = 0; i < tmp.size(); ++i) {
-      tmp[i] = ~tmp[i];
-    }
-    tmp.Normalize();
-    for (int64 i = 0; i < tmp.size(); ++i) {
-      if (++tmp[i])
-        break;
-    }
-    if (tmp.leading() == 0)
-      tmp.push_leading(1);
+  // Initialize.  a = da * (2^64)^(2h), where da has the leading limbs.
+  const int64 lead = a.size() + a.exponent() - 1;
+  const int64 h = (lead >= 0) ? lead / 2 : -((1 - lead) / 2);
+  double da = a.leading();
+  if (a.size() > 1) {
+    da += a[a.size() - 2] * kPow2_m64;
+  }
+  if (lead != 2 * h)
+    da *= kPow2_64;
+  *val = 1.0 / std::sqrt(da);
+  val->exponent_ -= h;
 
-    Div(tmp, 2, &tmp);
-    // TODO: in this multiplication, &tmp needs to be extended.
-    // Currently, the size of |tmp| is not updated.
-    Mult(*val, tmp, &tmp);
-    tmp.Normalize();
+  Real a_k, val_a, tmp;
+  double max_error = 0;
+  int64 known = 0;
+  for (int64 k : NewtonPrecisions(length)) {
+    // tmp = 1 - (val * a) * val, whose leading half cancels.  Each iteration
+    // refers |a| only in the precision it needs.
+    Truncate(a, k + 1, &a_k);
+    if (a_k.size() == 1) {
+      Mult(*val, a_k[0], &val_a);
+      val_a.exponent_ += a_k.exponent();
+    } else {
+      val_a.setPrecision(k + 2);
+      max_error = std::max(max_error, Mult(*val, a_k, &val_a));
+    }
+    bool negative;
+    double err = OneMinusMult(val_a, *val, k + 1, known, &tmp, &negative);
+    max_error = std::max(err, max_error);
+    known = k - 3;
 
+    // val += val * tmp / 2
     val->setPrecision(k);
-    Add(*val, tmp, val);
+    if (tmp.size() == 0)
+      continue;
+    Mult(*val, tmp, &tmp);
+    Div(tmp, 2, &tmp);
+    if (negative)
+      Sub(tmp, val);
+    else
+      Add(tmp, val);
   }
 
   val->setPrecision(length);
@@ -112,6 +686,49 @@ double Real::InverseSqrt(uint64 a, Real* val) {
   return max_error;
 }
 
+double Real::Sqrt(const Real& a, Real* val) {
+  DCHECK(&a != val);
+  const int64 length = val->precision();
+  const int64 half = length / 2 + 2;
+  double max_error = 0;
+
+  // r = 1/sqrt(a) and t = a*r in a half precision.
+  Real r;
+  r.setPrecision(half);
+  max_error = std::max(max_error, InverseSqrt(a, &r));
+  Real a_half, t;
+  Truncate(a, half + 1, &a_half);
+  t.setPrecision(half);
+  max_error = std::max(max_error, Mult(a_half, r, &t));
+
+  // Karp-Markstein: sqrt(a) = t + r*(a - t^2)/2, where the leading half of
+  // a - t^2 cancels.
+  Real a_full, t2, e;
+  Truncate(a, length + 2, &a_full);
+  t2.setPrecision(2 * t.size());
+  max_error = std::max(max_error, Mult(t, t, &t2));
+  const bool negative = CompareValues(a_full, t2) < 0;
+  e.setPrecision(length + 2);
+  if (negative)
+    Sub(t2, a_full, &e);
+  else
+    Sub(a_full, t2, &e);
+
+  Real d;
+  d.setPrecision(length - half + 3);
+  if (e.size()) {
+    max_error = std::max(max_error, Mult(r, e, &d));
+    Div(d, 2, &d);
+  }
+  val->setPrecision(length);
+  if (negative)
+    Sub(t, d, val);
+  else
+    Add(t, d, val);
+
+  return max_error;
+}
+
 double Real::Inverse(const Real& a, Real* val) {
   DCHECK(&a != val);
 
@@ -135,27 +752,27 @@ double Real::Inverse(const Real& a, Real* val) {
   *val = (1.0 - (1.0 / (1ULL << 52))) / da;
   val->exponent_ = -(a.exponent() + a.size()) - val->size() + 1;
 
+  Real a_k;
   double max_error = 0;
-  for (int64 k = 2; k < length * 2; k *= 2) {
-    tmp.setPrecision(k);
-    double err = Mult(a, *val, &tmp);
+  int64 known = 0;
+  for (int64 k : NewtonPrecisions(length)) {
+    // tmp = 1 - a * val, whose leading half cancels.  Each iteration refers
+    // |a| only in the precision it needs.
+    Truncate(a, k + 1, &a_k);
+    bool negative;
+    double err = OneMinusMult(a_k, *val, k + 1, known, &tmp, &negative);
     max_error = std::max(max_error, err);
+    known = k - 3;
 
-    // Computing "1 - |tmp|", assuming |tmp| is a bit smaller than 1.
-    for (int64 i = 0; i < tmp.size(); ++i) {
-      tmp[i] = ~tmp[i];
-    }
-    tmp.Normalize();
-    for (int64 i = 0; i < tmp.size(); ++i) {
-      if (++tmp[i])
-        break;
-    }
-    if (tmp.leading() == 0)
-      tmp.push_leading(1);
-
+    // val += val * tmp
+    val->setPrecision(k);
+    if (tmp.size() == 0)
+      continue;
     Mult(*val, tmp, &tmp);
-    val->setPrecision(k * 2);
-    Add(*val, tmp, val);
+    if (negative)
+      Sub(tmp, val);
+    else
+      Add(tmp, val);
   }
 
   val->setPrecision(length);
@@ -172,6 +789,7 @@ void Real::Add(const Real& a, const Real& b, Real* c) {
   int64 c_exp = std::min(a.exponent(), b.exponent());
 
   Real sum;
+  sum.reset(c_lead - c_exp + 1);
   sum.resize(c_lead - c_exp);
   for (int64 i = 0; i < c_lead - c_exp; ++i)
     sum[i] = 0;
@@ -218,9 +836,39 @@ void Real::Add(const Real& a, const Real& b, Real* c) {
   sum.setPrecision(prec);
   sum.Normalize();
 
-  c->release();
-  *c = sum;
-  sum.release();
+  *c = std::move(sum);
+}
+
+void Real::Add(const Real& a, Real* c) {
+  DCHECK_NE(&a, c);
+  if (a.size() == 0)
+    return;
+  const int64 prec = c->precision();
+  if (c->size() == 0) {
+    Truncate(a, prec, c);
+    return;
+  }
+
+  const int64 a_lead = a.size() + a.exponent();
+  const int64 lead = std::max(a_lead, c->size() + c->exponent());
+  const int64 low =
+      std::max(lead - prec, std::min(a.exponent(), c->exponent()));
+  uint64 carry = CarryUnder(a, *c, low);
+  FitLimbs(low, lead, c);
+
+  int64 i = carry ? low : std::max(low, a.exponent());
+  for (; i < lead && (carry || i < a_lead); ++i) {
+    uint64& x = (*c)[i - low];
+    const uint64 y = LimbAt(a, i);
+    x += carry;
+    carry = (x < carry) ? 1 : 0;
+    x += y;
+    carry += (x < y) ? 1 : 0;
+  }
+  if (carry)
+    c->push_leading(carry);
+
+  c->Normalize();
 }
 
 void Real::Sub(const Real& a, const Real& b, Real* c) {
@@ -244,12 +892,11 @@ void Real::Sub(const Real& a, const Real& b, Real* c) {
     diff[ic] = a[ia];
   }
   for (; ic < ica && ib < b.size(); ++ic, ++ib) {
-    diff[ic] = ~b[ib];
-    borrow = 1;
+    diff[ic] = 0 - b[ib] - borrow;
+    borrow = (b[ib] | borrow) ? 1 : 0;
   }
   for (; ic < ica; ++ic) {
-    diff[ic] = ~0ULL;
-    borrow = 1;
+    diff[ic] = 0 - borrow;
   }
 
   // Now our situation is
@@ -276,10 +923,65 @@ void Real::Sub(const Real& a, const Real& b, Real* c) {
   diff.setPrecision(prec);
   diff.Normalize();
 
-  *c = diff;
+  *c = std::move(diff);
+}
+
+void Real::Sub(const Real& a, Real* c) {
+  DCHECK_NE(&a, c);
+  if (a.size() == 0)
+    return;
+  DCHECK_GE(c->size() + c->exponent(), a.size() + a.exponent());
+
+  const int64 prec = c->precision();
+  const int64 a_lead = a.size() + a.exponent();
+  const int64 lead = c->size() + c->exponent();
+  const int64 low =
+      std::max(lead - prec, std::min(a.exponent(), c->exponent()));
+  uint64 borrow = BorrowUnder(*c, a, low);
+  FitLimbs(low, lead, c);
+
+  int64 i = borrow ? low : std::max(low, a.exponent());
+  for (; i < lead && (borrow || i < a_lead); ++i) {
+    uint64& x = (*c)[i - low];
+    const uint64 t = x - borrow;
+    borrow = (t > x) ? 1 : 0;
+    x = t - LimbAt(a, i);
+    borrow += (x > t) ? 1 : 0;
+  }
+  DCHECK_EQ(0ULL, borrow);
+
+  c->Normalize();
+}
+
+void Real::FitLimbs(const int64 low, const int64 lead, Real* c) {
+  if (c->exponent_ < low)
+    c->erase(0, low - c->exponent_);
+  else if (c->exponent_ > low)
+    c->insert(0, c->exponent_ - low, 0);
+  c->exponent_ = low;
+  if (c->size() < lead - low)
+    c->insert(c->size(), lead - low - c->size(), 0);
 }
 
 double Real::Mult(const Real& a, const Real& b, Real* c) {
+  // Trailing limbs of a long operand affect only limbs under c's precision,
+  // except for carries.  Drop them to make a short product.
+  const int64 keep = c->precision() + 2;
+  if (c->precision() > 0 && (a.size() > keep || b.size() > keep)) {
+    Real a_short, b_short;
+    const Real* pa = &a;
+    const Real* pb = &b;
+    if (a.size() > keep) {
+      Truncate(a, keep, &a_short);
+      pa = &a_short;
+    }
+    if (b.size() > keep) {
+      Truncate(b, keep, &b_short);
+      pb = &b_short;
+    }
+    return Mult(*pa, *pb, c);
+  }
+
   double err = Integer::Mult(a, b, c);
   c->exponent_ = a.exponent() + b.exponent();
   c->Normalize();
@@ -294,54 +996,211 @@ void Real::Mult(const Real& a, const uint64 b, Real* c) {
 }
 
 void Real::Div(const Real& a, const uint64 b, Real* c) {
-  int64 prec = c->precision();
+  const int64 prec = c->precision();
+  // Extend the dividend with |diff| zero limbs to keep the precision.
+  const int64 diff = std::max<int64>(prec - a.size(), 0);
+
+  // Divide in place if |c| is |a| and no extension is needed.  Otherwise
+  // |c|'s buffer is reused unless it is |a|.
+  Real quot(a.base());
+  Real* q = (c == &a && diff > 0) ? &quot : c;
+  if (q != &a)
+    q->reset(a.size() + diff);
+
+  uint64 rem = Natural::Div(a.data(), b, a.size(), q->data() + diff);
+  Natural::Div(rem, b, diff, q->data());
+  q->exponent_ = a.exponent_ - diff;
+  q->precision_ = prec;
+  q->Normalize();
+  if (q != c)
+    c->swap(quot);
+}
 
-  *c = a;
-  c->exponent_ = a.exponent_;
-  if (c->precision() > c->size()) {
-    int64 diff = c->precision() - c->size();
-    c->insert(0, diff, 0);
-    c->exponent_ -= diff;
+double Real::Div(const Real& a, const Real& b, Real* c) {
+  const int64 length = c->precision();
+  const int64 half = length / 2 + 2;
+  double max_error = 0;
+
+  // y = 1/b and q = a*y in a half precision.
+  Real y;
+  y.setPrecision(half);
+  max_error = std::max(max_error, Inverse(b, &y));
+  Real a_half;
+  Truncate(a, half + 1, &a_half);
+  Real q;
+  q.setPrecision(half);
+  max_error = std::max(max_error, Mult(a_half, y, &q));
+
+  // Karp-Markstein: a/b = q + y*(a - b*q), where the leading half of
+  // a - b*q cancels.
+  Real a_full, b_full, bq, r;
+  Truncate(a, length + 2, &a_full);
+  Truncate(b, length + 1, &b_full);
+  bq.setPrecision(length + 2);
+  max_error = std::max(max_error, Mult(b_full, q, &bq));
+  const bool negative = CompareValues(a_full, bq) < 0;
+  r.setPrecision(length + 2);
+  if (negative)
+    Sub(bq, a_full, &r);
+  else
+    Sub(a_full, bq, &r);
+
+  Real yr;
+  yr.setPrecision(length - half + 2);
+  if (r.size())
+    max_error = std::max(max_error, Mult(y, r, &yr));
+  q.setPrecision(length);
+  c->setPrecision(length);
+  if (negative)
+    Sub(q, yr, c);
+  else
+    Add(q, yr, c);
+
+  return max_error;
+}
+
+double Real::MultSqrt(const Real& a,
+                      const uint64 x,
+                      const Real& inverse_sqrt,
+                      Real* c) {
+  const int64 length = c->precision();
+  const int64 half = length / 2 + 2;
+  DCHECK_GE(inverse_sqrt.size(), std::min(half, inverse_sqrt.precision()));
+  double max_error = 0;
+
+  // t = x*r approximates sqrt(x) in a half precision.
+  Real r, t;
+  Truncate(inverse_sqrt, half, &r);
+  Mult(r, x, &t);
+
+  // e = x - t^2, whose leading half cancels.
+  Real x_real, t2, e;
+  x_real.setPrecision(1);
+  x_real.resize(1);
+  x_real[0] = x;
+  x_real.setExponent(0);
+  t2.setPrecision(2 * t.size());
+  max_error = std::max(max_error, Mult(t, t, &t2));
+  const bool negative = CompareValues(x_real, t2) < 0;
+  e.setPrecision(length + 2);
+  if (negative)
+    Sub(t2, x_real, &e);
+  else
+    Sub(x_real, t2, &e);
+
+  // Karp-Markstein: a*sqrt(x) = a*t + (a*r)*e/2.
+  Real a_full, s;
+  Truncate(a, length + 1, &a_full);
+  s.setPrecision(length + 1);
+  max_error = std::max(max_error, Mult(a_full, t, &s));
+
+  Real a_low, ar, d;
+  Truncate(a, length - half + 3, &a_low);
+  ar.setPrecision(length - half + 3);
+  max_error = std::max(max_error, Mult(a_low, r, &ar));
+  d.setPrecision(length - half + 3);
+  if (e.size()) {
+    max_error = std::max(max_error, Mult(ar, e, &d));
+    Div(d, 2, &d);
   }
-  Integer::Div(*c, b, c);
-  c->setPrecision(prec);
-  c->Normalize();
+
+  c->setPrecision(length);
+  if (negative)
+    Sub(s, d, c);
+  else
+    Add(s, d, c);
+
+  return max_error;
 }
 
 // static
-void Real::ConvertBase(const Real& a, Real& b) {
+int64 Real::HexLimbsForDecimal(const int64 n) {
+  return static_cast<int64>(std::ceil(n * kHexLimbsPerDec)) +
+         kConvertGuardLimbs;
+}
+
+// static
+void Real::ConvertBase(const Real& a, Real& b, const int64 num_threads) {
   CHECK_NE(a.base(), b.base());
   if (a.base() == Integer::Base::kHex) {
-    HexToDecimal(a, b);
+    HexToDecimal(a, b, num_threads);
   }
 }
 
-int64 Real::Compare(std::string& filename) {
-  std::ifstream ifs(filename.c_str());
-  if (!ifs.is_open()) {
-    LOG(INFO) << "Cannot read " << filename << "\n";
+int64 Real::Compare(const std::string& filename,
+                    const int64 num_threads) const {
+  ReferenceDigits reference(filename);
+  if (!reference.ok()) {
+    LOG(INFO) << "Cannot read " << filename;
     return 0;
   }
 
-  char refer[20];
-  ifs.read(refer, 2);
-  if (std::strncmp(refer, "0.", 2)) {
-    LOG(INFO) << filename << " may have a wrong format\n";
-    return 0;
+  const bool hex = (base() == Base::kHex);
+  const int64 width = hex ? 16 : 19;
+  const int64 num_digits =
+      std::min(std::max<int64>(-exponent_, 0) * width, reference.num_digits());
+  const int64 num_limbs = (num_digits + width - 1) / width;
+
+  // Chunks of limbs are compared in parallel.  Each chunk stops at its
+  // first mismatch, and skips limbs after a mismatch found in others.
+  std::atomic<int64> mismatch(num_digits);
+  const int64 num_chunks = std::min(num_limbs, num_threads * 8);
+  std::vector<std::function<void()>> tasks;
+  for (int64 c = 0; c < num_chunks; ++c) {
+    tasks.push_back([&, c] {
+      const int64 end = num_limbs * (c + 1) / num_chunks;
+      for (int64 k = num_limbs * c / num_chunks; k < end; ++k) {
+        const int64 digit = k * width;
+        if (digit >= mismatch.load(std::memory_order_relaxed))
+          return;
+        const int64 found =
+            FindMismatch(reference, LimbAt(*this, -1 - k), digit,
+                         std::min(width, num_digits - digit), hex);
+        if (found < 0)
+          continue;
+        int64 first = mismatch.load();
+        while (found < first && !mismatch.compare_exchange_weak(first, found)) {
+        }
+        return;
+      }
+    });
   }
+  base::ThreadPool pool(num_threads);
+  pool.Run(tasks);
+  return mismatch;
+}
 
-  int64 match = -16;
-  for (int64 i = size() - 1; i >= 0 && !ifs.eof(); --i) {
-    char buffer[20];
-    ifs.read(refer, 16);
-    std::sprintf(buffer, "%016" PRIX64, (*this)[i]);
-    for (int64 j = 0; j < 16; ++j) {
-      if (buffer[j] != refer[j])
-        return match + j;
-    }
-    match += 16;
+// static
+Real::DecimalSink Real::CompareDecimal(const std::string& filename,
+                                       int64* matched) {
+  *matched = 0;
+  std::shared_ptr<ReferenceDigits> reference(new ReferenceDigits(filename));
+  if (!reference->ok()) {
+    LOG(INFO) << "Cannot read " << filename;
+    return [](const uint64*, int64) {};
   }
-  return match;
+
+  // The first block has the integral part, and digits are compared from
+  // the next one.  Calls of sinks are serialized, and need no locks.
+  struct State {
+    bool integral = true;
+    // Set at the end of the reference, or at the first mismatch.
+    bool done = false;
+  };
+  std::shared_ptr<State> state(new State);
+  return [reference, state, matched](const uint64* limbs, int64 n) {
+    if (state->integral) {
+      state->integral = false;
+      return;
+    }
+    for (int64 i = 0; i < n && !state->done; ++i) {
+      const int64 digit = *matched;
+      const int64 k = std::min<int64>(19, reference->num_digits() - digit);
+      const int64 found = FindMismatch(*reference, limbs[i], digit, k, false);
+      *matched = (found < 0) ? digit + k : found;
+      state->done = (found >= 0 || *matched == reference->num_digits());
+    }
+  };
 }
 
 void Real::setPrecision(int64 prec) {
@@ -353,6 +1212,12 @@ void Real::setPrecision(int64 prec) {
   Normalize();
 }
 
+void Real::swap(Real& other) {
+  Integer::swap(other);
+  std::swap(precision_, other.precision_);
+  std::swap(exponent_, other.exponent_);
+}
+
 Real& Real::operator=(const Real& other) {
   DCHECK_EQ(base(), other.base());
 
@@ -362,6 +1227,15 @@ Real& Real::operator=(const Real& other) {
   return (*this);
 }
 
+Real& Real::operator=(Real&& other) {
+  DCHECK_EQ(base(), other.base());
+
+  Integer::operator=(std::move(other));
+  precision_ = other.precision();
+  exponent_ = other.exponent();
+  return (*this);
+}
+
 Real& Real::operator=(double d) {
   if (d == 0.0) {
     clear();
@@ -382,14 +1256,15 @@ Real& Real::operator=(double d) {
 
   uint64 lead = static_cast<uint64>(d);
   if (d == static_cast<double>(lead)) {
-    resize(1);
+    reset(1);
     (*this)[0] = lead;
     precision_ = 1;
   } else {
-    resize(2);
+    reset(2);
     (*this)[0] = static_cast<uint64>((d - lead) * kPow2_64);
     (*this)[1] = lead;
     precision_ = 2;
+    --e;
   }
   exponent_ = e;
 
@@ -416,25 +1291,32 @@ int64 Real::TailingZero() {
 }
 
 // static
-void Real::HexToDecimal(const Real& a, Real& b) {
-  static constexpr uint64 kDecBase = 10000000000000000000ULL;
-
-  int64 integral_size = a.size() + a.exponent();
-  // TODO: Make this routine general.
-  CHECK_EQ(1, integral_size);
-  CHECK_EQ(3, a[a.size() - 1]);
-
-  int64 sz = b.precision();
+void Real::HexToDecimal(const Real& a, Real& b, const int64 num_threads) {
+  const int64 sz = b.precision();
   b.exponent_ = -sz;
-  b.resize(sz + 1);
-  b[b.size() - 1] = a[a.size() - 1];
+  ConvertHexToDecimal(
+      a, sz, num_threads, false,
+      [&b, sz](int64 offset, const uint64* limbs, int64 n) {
+        if (offset < 0)
+          b.resize(sz - offset);
+        // Limbs are stored from the least significant one.
+        uint64* dst = b.data() + sz - offset - n;
+        std::reverse_copy(limbs, limbs + n, dst);
+      });
+}
 
-  // Rational part
-  Real tmp(a);
-  tmp.resize(tmp.size() - 1);
-  for (int64 i = b.size() - 2; i >= 0; --i) {
-    b[i] = Natural::Mult(tmp.data(), kDecBase, tmp.size(), tmp.data());
-  }
+// static
+void Real::ConvertToDecimal(const Real& a,
+                            const int64 precision,
+                            const DecimalSink& sink,
+                            const int64 num_threads) {
+  CHECK(a.base() == Integer::Base::kHex);
+  OrderedBlocks blocks(sink);
+  ConvertHexToDecimal(
+      a, precision, num_threads, true,
+      [&blocks](int64 offset, const uint64* limbs, int64 n) {
+        blocks.Put(offset, limbs, n);
+      });
 }
 
 std::ostream& operator<<(std::ostream& os, const Real& val) {
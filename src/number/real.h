@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <ostream>
 #include <string>
 
@@ -16,42 +17,100 @@ class Real : public Integer {
   explicit Real(const Base = Base::kHex);
   explicit Real(double d, const Base = Base::kHex);
   explicit Real(const Real& other);
+  Real(Real&& other);
 
   void fitInteger(int64 n);
 
   // Computes 1/\sqrt{a}.  Returns the maximum rounding error.
   static double InverseSqrt(uint64 a, Real* val);
+  // Computes 1/\sqrt{a} for a positive |a|, with Newton iterations which
+  // double the precision in each.  Returns the maximum rounding error.
+  static double InverseSqrt(const Real& a, Real* val);
+  // Computes \sqrt{a} in val's precision.  The inverse square root is
+  // computed in a half precision, and the root is corrected with a
+  // Karp-Markstein step.  Returns the maximum rounding error.
+  static double Sqrt(const Real& a, Real* val);
 
   // Compute 1/a.
   static double Inverse(const Real& a, Real* val);
 
   // Comptues c=a+b
   static void Add(const Real& a, const Real& b, Real* c);
-  // Computes c+=a
+  // Computes c+=a in c's precision.  It works in c's buffer, and reads
+  // limbs of a only in the precision, except for a carry from lower limbs.
   static void Add(const Real& a, Real* c);
 
   // Comptues c=a-b
   static void Sub(const Real& a, const Real& b, Real* c);
+  // Computes c-=a, assuming c >= a, in the same way as Add(a, c).  The
+  // precision is counted from the leading limb of c before the subtraction,
+  // so that it is not for subtractions whose leading limbs cancel.
+  static void Sub(const Real& a, Real* c);
 
-  // Computes c=a*b
+  // Computes c=a*b in c's precision.  Operands are referred only in the
+  // precision, as a short product.
   static double Mult(const Real& a, const Real& b, Real* c);
   static void Mult(const Real& a, const uint64 b, Real* c);
 
   // Computes c=a/b.
   static void Div(const Real& a, const uint64 b, Real* c);
-
-  static void ConvertBase(const Real& a, Real& b);
-
-  // Compares with the content of the file, and returns the number of
-  // matched continuous digits.
+  // Computes c=a/b in c's precision.  The inverse of b is computed in a
+  // half precision, and the quotient is corrected with a Karp-Markstein
+  // step.  Returns the maximum rounding error.
+  static double Div(const Real& a, const Real& b, Real* c);
+
+  // Computes c=a*sqrt(x) in c's precision, with a Karp-Markstein step
+  // from |inverse_sqrt|, which has 1/sqrt(x) in at least a half of c's
+  // precision.  Returns the maximum rounding error.
+  static double MultSqrt(const Real& a,
+                         const uint64 x,
+                         const Real& inverse_sqrt,
+                         Real* c);
+
+  // Converts |a| into |b| in b's base, with b's precision under the point.
+  // The conversion from hexadecimal splits the fraction in a scaled
+  // remainder tree, and runs subtrees in |num_threads| threads.
+  static void ConvertBase(const Real& a, Real& b, const int64 num_threads = 1);
+  // Returns the number of hexadecimal limbs under the point, which are
+  // read to convert |n| decimal limbs, including guard limbs.
+  static int64 HexLimbsForDecimal(const int64 n);
+
+  // Receives decimal limbs in the order from the leading one.  |limbs| are
+  // valid only in the call.
+  using DecimalSink = std::function<void(const uint64* limbs, int64 n)>;
+  // Converts hexadecimal |a| into decimal, with |precision| limbs under the
+  // point, and passes limbs to |sink| in blocks as soon as they are fixed.
+  // The first block has the integral part.  Calls of |sink| are serialized.
+  static void ConvertToDecimal(const Real& a,
+                               const int64 precision,
+                               const DecimalSink& sink,
+                               const int64 num_threads = 1);
+  // Returns a sink for ConvertToDecimal(), which compares digits under the
+  // point with a reference file like Compare() while they are converted.
+  // The number of matched continuous digits is kept in |matched|.
+  static DecimalSink CompareDecimal(const std::string& filename,
+                                    int64* matched);
+
+  // Compares digits under the point with a reference file in the same
+  // base, and returns the number of matched continuous digits, i.e. the
+  // offset of the first mismatch.  The file is memory-mapped, and is
+  // compared in |num_threads| threads.  It has a header which ends with
+  // the point, like "0." or "pi = 3.\n", and digits in lines of a fixed
+  // width, or in a line.
   // If the file is not readable, returns 0.
-  int64 Compare(std::string& filename);
+  int64 Compare(const std::string& filename,
+                const int64 num_threads = 1) const;
 
   int64 exponent() const { return exponent_; }
+  void setExponent(int64 e) { exponent_ = e; }
   int64 precision() const { return precision_; }
   void setPrecision(int64 prec);
 
+  // Swaps values, including precisions, with |other|.
+  void swap(Real& other);
+
   Real& operator=(const Real& other);
+  Real& operator=(Real&& other);
   Real& operator=(double d);
 
  protected:
@@ -63,7 +122,21 @@ class Real : public Integer {
   // Returns the number zeros in tail.
   int64 TailingZero();
 
-  static void HexToDecimal(const Real& a, Real& b);
+  static void HexToDecimal(const Real& a, Real& b, const int64 num_threads);
+
+  // Moves limbs in c's buffer, so that c has limbs for [low, lead) in
+  // exponents.  Limbs under |low| are dropped.
+  static void FitLimbs(const int64 low, const int64 lead, Real* c);
+
+  // Computes d = |1 - a*b| in |n| limbs under the point, where a*b matches 1
+  // in |known| limbs under the point, and sets whether a*b > 1 in
+  // |negative|.  Returns the maximum rounding error.
+  static double OneMinusMult(const Real& a,
+                             const Real& b,
+                             const int64 n,
+                             const int64 known,
+                             Real* d,
+                             bool* negative);
 
   int64 precision_;
   int64 exponent_;
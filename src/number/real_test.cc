@@ -2,7 +2,13 @@
 
 #include <gtest/gtest.h>
 
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <sstream>
+#include <string>
+#include <vector>
 
 namespace ppi {
 namespace number {
@@ -32,5 +38,304 @@ TEST(RealTest, Inverse) {
   EXPECT_EQ(expect, oss.str().substr(0, expect.size()));
 }
 
+TEST(RealTest, InverseSqrtReal) {
+  Real a(355.0);
+  a.setExponent(3);
+  Real val;
+  val.setPrecision(10);
+  Real::InverseSqrt(a, &val);
+  std::ostringstream oss;
+  oss << std::hex << val;
+
+  // 1/sqrt(355 * 2^192) = 0x0.0D964A2B8D6BB9B6335DC...p-96
+  const std::string expect =
+      "D964A2B8D6BB9B6335DC63D086D84FF3BC037924C2B326E758B6F79106B9207A7F"
+      "1BE3EA8515F110B6CA26338CF9ABBD2FED0CC7F2C8DEB5C0A77383EB54";
+  EXPECT_EQ(expect, oss.str().substr(0, expect.size()));
+}
+
+TEST(RealTest, Sqrt) {
+  Real a(3.0);
+  Real val;
+  val.setPrecision(10);
+  Real::Sqrt(a, &val);
+  std::ostringstream oss;
+  oss << std::hex << val;
+
+  // sqrt(3) = 0x1.BB67AE8584CAA73B...
+  const std::string expect =
+      "1BB67AE8584CAA73B25742D7078B83B8925D834CC53DA4798C720A6486E45A6E2"
+      "490BCFD95EF15DBDA9930AAE12228F87CC4CF24DA3A1EC68D0CD33A01AD9A";
+  EXPECT_EQ(expect, oss.str().substr(0, expect.size()));
+}
+
+TEST(RealTest, AddInPlace) {
+  Real a, c, expect;
+  a.setPrecision(3);
+  a.resize(3);
+  a[0] = 1;
+  a[1] = 1;
+  a[2] = 5;
+  a.setExponent(-3);
+
+  // The carry comes from limbs under the precision.
+  for (Real* r : {&c, &expect}) {
+    r->setPrecision(2);
+    r->resize(2);
+    (*r)[0] = ~0ULL;
+    (*r)[1] = ~0ULL;
+    r->setExponent(-3);
+  }
+  Real::Add(expect, a, &expect);
+  Real::Add(a, &c);
+
+  ASSERT_EQ(2, c.size());
+  EXPECT_EQ(-2, c.exponent());
+  EXPECT_EQ(1ULL, c[0]);
+  EXPECT_EQ(6ULL, c[1]);
+  ASSERT_EQ(expect.size(), c.size());
+  EXPECT_EQ(expect.exponent(), c.exponent());
+  for (int64 i = 0; i < c.size(); ++i) {
+    EXPECT_EQ(expect[i], c[i]) << "for i = " << i;
+  }
+}
+
+TEST(RealTest, SubInPlace) {
+  Real a, c, expect;
+  a.setPrecision(2);
+  a.resize(2);
+  a[0] = 1;
+  a[1] = 0x10ULL;
+  a.setExponent(-6);
+
+  // The borrow comes from limbs under the precision.
+  for (Real* r : {&c, &expect}) {
+    r->setPrecision(4);
+    r->resize(4);
+    (*r)[0] = 0;
+    (*r)[1] = 0;
+    (*r)[2] = 0;
+    (*r)[3] = 5;
+    r->setExponent(-3);
+  }
+  Real::Sub(expect, a, &expect);
+  Real::Sub(a, &c);
+
+  ASSERT_EQ(4, c.size());
+  EXPECT_EQ(~0ULL, c[0]);
+  EXPECT_EQ(4ULL, c[3]);
+  ASSERT_EQ(expect.size(), c.size());
+  EXPECT_EQ(expect.exponent(), c.exponent());
+  for (int64 i = 0; i < c.size(); ++i) {
+    EXPECT_EQ(expect[i], c[i]) << "for i = " << i;
+  }
+}
+
+TEST(RealTest, DivReal) {
+  Real a(355.0);
+  Real b(113.0);
+  Real val;
+  val.setPrecision(10);
+  Real::Div(a, b, &val);
+  std::ostringstream oss;
+  oss << std::hex << val;
+
+  // 355/113 = 0x3.243F6F0243F6F0...
+  const std::string expect =
+      "3243F6F0243F6F0243F6F0243F6F0243F6F0243F6F0243F6F0243F6F0243F6F02"
+      "43F6F0243F6F0243F6F0243F6F0243F6F0243F6F0243F6F0243F6F0";
+  EXPECT_EQ(expect, oss.str().substr(0, expect.size()));
+}
+
+TEST(RealTest, MultSqrt) {
+  Real inv;
+  inv.setPrecision(7);
+  Real::InverseSqrt(2, &inv);
+  Real a(3.0);
+  Real val;
+  val.setPrecision(10);
+  Real::MultSqrt(a, 2, inv, &val);
+  std::ostringstream oss;
+  oss << std::hex << val;
+
+  // 3 * sqrt(2) = 0x4.3E1DB337DB365B...
+  const std::string expect =
+      "43E1DB337DB365B1A18F13A34BFC077BAB09C445F3765F1CD8E8E0B211335967"
+      "FC1EB12196053D095F42BF69F2B1723565CBBF23595AAE3BED01B2B4";
+  EXPECT_EQ(expect, oss.str().substr(0, expect.size()));
+}
+
+TEST(RealTest, ConvertBase) {
+  // 12345678901234567890123456789.5
+  Real a;
+  a.setPrecision(3);
+  a.resize(3);
+  a[0] = 0x8000000000000000ULL;
+  a[1] = 0x46BEC9B16E398115ULL;
+  a[2] = 0x27E41B32ULL;
+  a.setExponent(-1);
+
+  Real b(Integer::Base::kDecimal);
+  b.setPrecision(3);
+  Real::ConvertBase(a, b);
+
+  ASSERT_EQ(5, b.size());
+  EXPECT_EQ(-3, b.exponent());
+  EXPECT_EQ(0ULL, b[0]);
+  EXPECT_EQ(0ULL, b[1]);
+  EXPECT_EQ(5000000000000000000ULL, b[2]);
+  EXPECT_EQ(1234567890123456789ULL, b[3]);
+  EXPECT_EQ(1234567890ULL, b[4]);
+}
+
+TEST(RealTest, ConvertLastHexLimb) {
+  // The number of hexadecimal limbs which n decimal limbs depend on.
+  auto needed = [](int64 n) {
+    return static_cast<int64>(std::ceil(n * 19 * std::log2(10.0L) / 64));
+  };
+  for (int64 n = 1000; n <= 1000000000000LL; n *= 10) {
+    EXPECT_LE(needed(n) + 2, Real::HexLimbsForDecimal(n)) << "for n = " << n;
+    EXPECT_GE(needed(n) + 3 + n / 1000000, Real::HexLimbsForDecimal(n))
+        << "for n = " << n;
+  }
+
+  // ~0 * 2^(-64m) is over 10^(-19n), and it appears in the last limb.
+  const int64 n = 1000;
+  const int64 m = needed(n);
+  Real a;
+  a.setPrecision(m);
+  a.resize(1);
+  a[0] = ~0ULL;
+  a.setExponent(-m);
+
+  Real b(Integer::Base::kDecimal);
+  b.setPrecision(n);
+  Real::ConvertBase(a, b);
+  ASSERT_LT(0, b.size());
+  EXPECT_EQ(-n, b.exponent());
+  EXPECT_NE(0ULL, b[0]);
+}
+
+TEST(RealTest, ConvertToDecimal) {
+  const int64 n = 3000;
+  Real a;
+  a.setPrecision(n);
+  a.resize(n);
+  for (int64 i = 0; i < n - 1; ++i)
+    a[i] = 0x0123456789ABCDEFULL * (i + 1);
+  a[n - 1] = 3;
+  a.setExponent(-(n - 1));
+
+  Real b(Integer::Base::kDecimal);
+  b.setPrecision(n);
+  Real::ConvertBase(a, b);
+
+  // Blocks come in the order from the leading limb, even if they are
+  // converted in parallel.
+  std::vector<uint64> limbs;
+  Real::ConvertToDecimal(
+      a, n,
+      [&limbs](const uint64* block, int64 size) {
+        limbs.insert(limbs.end(), block, block + size);
+      },
+      4);
+
+  ASSERT_EQ(b.size(), static_cast<int64>(limbs.size()));
+  for (int64 i = 0; i < b.size(); ++i) {
+    EXPECT_EQ(b[b.size() - 1 - i], limbs[i]) << "for i = " << i;
+  }
+}
+
+TEST(RealTest, Compare) {
+  const int64 n = 1000;
+  for (auto base : {Integer::Base::kHex, Integer::Base::kDecimal}) {
+    const bool hex = (base == Integer::Base::kHex);
+    Real a(base);
+    a.setPrecision(n + 1);
+    a.resize(n + 1);
+    for (int64 i = 0; i < n; ++i)
+      a[i] = 0x0123456789ABCDEFULL * (i + 1) % 10000000000000000000ULL;
+    a[n] = 3;
+    a.setExponent(-n);
+
+    std::string digits;
+    char buffer[24];
+    for (int64 i = n - 1; i >= 0; --i) {
+      std::sprintf(buffer, hex ? "%016" PRIX64 : "%019" PRIu64, a[i]);
+      digits += buffer;
+    }
+
+    // Digits in lines of 100 digits.
+    const std::string filename = "real_test_reference.txt";
+    {
+      std::ofstream ofs(filename);
+      ofs << "pi = 3.\n";
+      for (size_t i = 0; i < digits.size(); i += 100)
+        ofs << digits.substr(i, 100) << "\n";
+    }
+    EXPECT_EQ(static_cast<int64>(digits.size()), a.Compare(filename, 4));
+
+    // Digits in a line, with a mismatch.
+    const int64 mismatch = 1234;
+    digits[mismatch] = (digits[mismatch] == '1') ? '2' : '1';
+    {
+      std::ofstream ofs(filename);
+      ofs << "3." << digits.substr(0, 5000);
+    }
+    EXPECT_EQ(mismatch, a.Compare(filename, 4));
+
+    // A short reference.
+    {
+      std::ofstream ofs(filename);
+      ofs << "3." << digits.substr(0, 1000);
+    }
+    EXPECT_EQ(1000, a.Compare(filename));
+    std::remove(filename.c_str());
+  }
+}
+
+TEST(RealTest, CompareDecimal) {
+  const int64 n = 500;
+  Real a;
+  a.setPrecision(n);
+  a.resize(n);
+  for (int64 i = 0; i < n - 1; ++i)
+    a[i] = 0x0123456789ABCDEFULL * (i + 1);
+  a[n - 1] = 3;
+  a.setExponent(-(n - 1));
+
+  Real b(Integer::Base::kDecimal);
+  b.setPrecision(n);
+  Real::ConvertBase(a, b);
+  ASSERT_EQ(n + 1, b.size());
+  std::string digits;
+  char buffer[24];
+  for (int64 i = n - 1; i >= 0; --i) {
+    std::sprintf(buffer, "%019" PRIu64, b[i]);
+    digits += buffer;
+  }
+
+  const std::string filename = "real_test_decimal_reference.txt";
+  auto compare = [&](const std::string& reference) {
+    {
+      std::ofstream ofs(filename);
+      ofs << "pi = 3.\n" << reference;
+    }
+    int64 matched = -1;
+    Real::ConvertToDecimal(a, n, Real::CompareDecimal(filename, &matched), 4);
+    return matched;
+  };
+  EXPECT_EQ(static_cast<int64>(digits.size()), compare(digits));
+  // Mismatches in a limb, and at the first digit of a limb.
+  for (int64 mismatch : {1234, 19 * 100}) {
+    std::string reference = digits;
+    reference[mismatch] = (reference[mismatch] == '1') ? '2' : '1';
+    EXPECT_EQ(mismatch, compare(reference));
+  }
+  // A short reference.
+  EXPECT_EQ(1000, compare(digits.substr(0, 1000)));
+  std::remove(filename.c_str());
+}
+
 }  // namespace number
 }  // namespace ppi
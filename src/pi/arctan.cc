@@ -1,57 +1,196 @@
 #include "pi/arctan.h"
 
+#include <glog/logging.h>
+
+#include <algorithm>
 #include <cmath>
+#include <thread>
+#include <vector>
 
 #include "base/base.h"
 #include "base/timer.h"
+#include "drm/arctan_series.h"
+#include "number/natural.h"
 #include "number/real.h"
 
 namespace ppi {
 namespace pi {
 
+namespace {
+
+using number::Divisor;
+using number::Natural;
+
+// The maximum number of series terms accumulated in a pass.
+constexpr int64 kMaxTermsPerPass = 8;
+constexpr uint64 kMaxWord = ~0ULL;
+
+// Adds |b| to a[i..n), propagating the carry.
+inline void AddAt(uint64* a, int64 i, const int64 n, uint64 b) {
+  for (; b && i < n; ++i) {
+    a[i] += b;
+    b = (a[i] < b) ? 1 : 0;
+  }
+}
+
+// Subtracts |b| from a[i..n), propagating the borrow.
+inline void SubtractAt(uint64* a, int64 i, const int64 n, uint64 b) {
+  for (; b && i < n; ++i) {
+    uint64 t = a[i];
+    a[i] = t - b;
+    b = (a[i] > t) ? 1 : 0;
+  }
+}
+
+// Computes sum += coef * arctan(1/x) in fixed point, where sum[n] is the
+// integral part and sum[0..n) is the fractional part.
+// Each pass over the limbs divides the running power coef/x^(2i+1) by
+// x^(2k), and accumulates k terms coef/(x^(2(i+j)+1)(2(i+j)+1)) at once,
+// as long as all the divisors fit in a word.
+void AddArctanSeries(const int64 coef,
+                     const uint64 x,
+                     const int64 n,
+                     uint64* sum) {
+  const uint64 x2 = x * x;
+  DCHECK_EQ(x, x2 / x);
+  const bool negative = coef < 0;
+  const uint64 c = negative ? -coef : coef;
+
+  // power[n+1] = coef / x
+  std::vector<uint64> power(n + 1);
+  power[n] = c / x;
+  Natural::Div(c % x, x, n, power.data());
+
+  int64 top = n;
+  while (top >= 0 && power[top] == 0)
+    --top;
+
+  std::vector<Divisor> terms;
+  terms.reserve(kMaxTermsPerPass);
+  for (int64 i = 0; top >= 0;) {
+    int64 k = 1;
+    uint64 power_divisor = x2;
+    while (k < kMaxTermsPerPass && power_divisor <= kMaxWord / x2 &&
+           static_cast<uint64>(2 * (i + k) + 1) <= kMaxWord / power_divisor) {
+      power_divisor *= x2;
+      ++k;
+    }
+
+    terms.clear();
+    uint64 d = 1;
+    for (int64 j = 0; j < k; ++j, d *= x2)
+      terms.emplace_back(d * (2 * (i + j) + 1));
+    const Divisor power_div(power_divisor);
+
+    uint64 power_rem = 0;
+    uint64 term_rems[kMaxTermsPerPass]{};
+    for (int64 l = top; l >= 0; --l) {
+      const uint64 p = power[l];
+      power[l] = power_div.Div(power_rem, p, &power_rem);
+      for (int64 j = 0; j < k; ++j) {
+        const uint64 q = terms[j].Div(term_rems[j], p, &term_rems[j]);
+        if (((i + j) % 2 == 1) == negative)
+          AddAt(sum, l, n + 1, q);
+        else
+          SubtractAt(sum, l, n + 1, q);
+      }
+    }
+
+    i += k;
+    while (top >= 0 && power[top] == 0)
+      --top;
+  }
+}
+
+// Represents coef * arctan(1/x).
+struct ArctanTerm {
+  int64 coef;
+  uint64 x;
+};
+
+std::vector<ArctanTerm> GetTerms(const Arctan::Formula formula) {
+  switch (formula) {
+  case Arctan::Formula::kMachin:
+    LOG(INFO) << "Use Machin's formula";
+    return {{16, 5}, {-4, 239}};
+  case Arctan::Formula::kTakano:
+    LOG(INFO) << "Use Takano's formula";
+    return {{48, 49}, {128, 57}, {-20, 239}, {48, 110443}};
+  case Arctan::Formula::kStormer:
+    LOG(INFO) << "Use Stormer's formula";
+    return {{176, 57}, {28, 239}, {-48, 682}, {96, 12943}};
+  }
+
+  CHECK(false);
+  return {};
+}
+
+}  // namespace
+
 double Arctan::Machin(Real& pi) {
-  int64 length = pi.precision();
+  const int64 length = pi.precision();
+  // Use a guard limb to absorb truncation errors in each term.
+  const int64 n = length + 1;
+
   pi = 0.0;
+  pi.setPrecision(n + 1);
+  pi.resize(n + 1);
+  for (int64 i = 0; i <= n; ++i)
+    pi[i] = 0;
+
+  // pi = 16 * arctan(1/5) - 4 * arctan(1/239)
+  AddArctanSeries(16, 5, n, pi.data());
+  AddArctanSeries(-4, 239, n, pi.data());
+
+  pi.setExponent(-n);
   pi.setPrecision(length);
 
-  Real a(16.0 * 5);
-  Real sum(0.0);
-  Real b(0.0);
-
-  a.setPrecision(length);
-  sum.setPrecision(length);
-  b.setPrecision(length);
-  const int64 n5 = length * 64 / std::log2(25) + 2;
-  for (int64 i = 0; i < n5; ++i) {
-    Real::Div(a, 25, &a);
-    Real::Div(a, 2 * i + 1, &b);
-    if (i % 2 == 0) {
-      Real::Add(sum, b, &sum);
-    } else {
-      Real::Sub(sum, b, &sum);
+  return 0;
+}
+
+double Arctan::MachinLike(const Formula formula, Real& pi) {
+  const int64 length = pi.precision();
+  // Compute each term with a guard limb.
+  const int64 num_dec = (length + 1) * 16 * std::log10(16);
+  const std::vector<ArctanTerm> terms = GetTerms(formula);
+  const int64 num_terms = terms.size();
+
+  std::vector<Real> values(num_terms);
+  std::vector<double> errors(num_terms);
+  {
+    base::Timer timer;
+    std::vector<std::thread> threads;
+    for (int64 i = 0; i < num_terms; ++i) {
+      threads.emplace_back([&terms, &values, &errors, num_dec, i] {
+        drm::ArctanSeries series(terms[i].x);
+        errors[i] = series.compute(num_dec, &values[i]);
+      });
     }
+    for (auto& thread : threads)
+      thread.join();
+    timer.Stop();
+    LOG(INFO) << "Arctan terms: " << timer.GetTimeInSec() << " sec.";
   }
-  Real::Add(pi, sum, &pi);
-
-  a = 4 * 239.0;
-  sum = 0.0;
-  b = 0.0;
-  a.setPrecision(length);
-  sum.setPrecision(length);
-  b.setPrecision(length);
-  const int64 n239 = length * 64 / std::log2(239 * 239) + 2;
-  for (int64 i = 0; i < n239; ++i) {
-    Real::Div(a, 239 * 239, &a);
-    Real::Div(a, 2 * i + 1, &b);
-    if (i % 2 == 0) {
-      Real::Add(sum, b, &sum);
-    } else {
-      Real::Sub(sum, b, &sum);
+
+  // Add positive terms first, to keep the partial sum positive.
+  pi = 0.0;
+  pi.setPrecision(length + 1);
+  Real term;
+  for (bool positive : {true, false}) {
+    for (int64 i = 0; i < num_terms; ++i) {
+      if ((terms[i].coef > 0) != positive)
+        continue;
+      Real::Mult(values[i], std::abs(terms[i].coef), &term);
+      if (positive)
+        Real::Add(term, &pi);
+      else
+        Real::Sub(term, &pi);
+      values[i].clear();
     }
   }
-  Real::Sub(pi, sum, &pi);
+  pi.setPrecision(length);
 
-  return 0;
+  return *std::max_element(errors.begin(), errors.end());
 }
 
 }  // namespace pi
@@ -11,9 +11,20 @@ using number::Real;
 
 class Arctan {
  public:
+  enum class Formula {
+    kMachin,
+    kTakano,
+    kStormer,
+  };
+
   // Computes pi using arctan formula in O(n^2) algorithm.
   // Returns the maximum rounding error in Multiplications.
   static double Machin(Real& pi);
+
+  // Computes pi using a Machin-like formula.  Each arctan term is computed
+  // with binary splitting in its own thread.
+  // Returns the maximum rounding error in Multiplications.
+  static double MachinLike(const Formula formula, Real& pi);
 };
 
 }  // namespace pi
@@ -0,0 +1,205 @@
+#include "pi/digit_file.h"
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "base/thread_pool.h"
+#include "pi/digit_writer.h"
+
+namespace ppi {
+namespace pi {
+
+uint64 PackedChecksum(const uint64* limbs, const int64 n, uint64 sum) {
+  // Each step is a bijection of |sum|, so that a changed limb changes the
+  // checksum, and the rotation makes it depend on the order of limbs.
+  for (int64 i = 0; i < n; ++i) {
+    sum ^= limbs[i];
+    sum = ((sum << 23) | (sum >> 41)) * 0x9E3779B97F4A7C15ULL;
+  }
+  return sum;
+}
+
+DigitFile::DigitFile(const std::string& filename)
+    : data_(nullptr),
+      size_(0),
+      packed_(false),
+      base_(0),
+      digits_per_limb_(0),
+      data_offset_(0),
+      num_digits_(0),
+      num_limbs_(0),
+      block_limbs_(0),
+      index_offset_(0) {
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(ERROR) << "Failed to open " << filename;
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (ptr != MAP_FAILED) {
+      data_ = static_cast<const char*>(ptr);
+      size_ = st.st_size;
+    }
+  }
+  close(fd);
+  if (!data_) {
+    LOG(ERROR) << "Failed to map " << filename;
+    return;
+  }
+
+  if (size_ >= kPackedDataOffset &&
+      std::memcmp(data_, kPackedMagic, sizeof(kPackedMagic)) == 0) {
+    packed_ = true;
+    if (!ParsePacked()) {
+      LOG(ERROR) << filename << " is broken.";
+      munmap(const_cast<char*>(data_), size_);
+      data_ = nullptr;
+    }
+    return;
+  }
+  ParseText();
+}
+
+DigitFile::~DigitFile() {
+  if (data_)
+    munmap(const_cast<char*>(data_), size_);
+}
+
+int64 DigitFile::Read(const int64 begin, const int64 n, char* out) const {
+  if (begin < 0 || begin >= num_digits_ || n <= 0)
+    return 0;
+  const int64 size = std::min(n, num_digits_ - begin);
+
+  if (!packed_) {
+    // Copy digits line by line.
+    const int64 line = DigitWriter::kDigitsPerLine;
+    for (int64 i = 0; i < size;) {
+      const int64 digit = begin + i;
+      const int64 k = std::min(size - i, line - digit % line);
+      std::memcpy(out + i, data_ + data_offset_ + digit + digit / line, k);
+      i += k;
+    }
+    return size;
+  }
+
+  const uint64* limbs = reinterpret_cast<const uint64*>(data_ + data_offset_);
+  char buffer[24];
+  for (int64 i = 0; i < size;) {
+    const int64 digit = begin + i;
+    const int64 column = digit % digits_per_limb_;
+    const uint64 limb = limbs[digit / digits_per_limb_];
+    if (base_ == 16)
+      DigitWriter::FormatHex(limb, buffer);
+    else
+      DigitWriter::FormatDecimal(limb, buffer);
+    const int64 k = std::min(size - i, digits_per_limb_ - column);
+    std::memcpy(out + i, buffer + column, k);
+    i += k;
+  }
+  return size;
+}
+
+std::string DigitFile::Read(const int64 begin, const int64 n) const {
+  // |n| can be far more than the digits in the file, and the buffer is
+  // sized with the digits to copy.
+  std::string digits;
+  if (begin < 0 || begin >= num_digits_ || n <= 0)
+    return digits;
+  digits.resize(std::min(n, num_digits_ - begin));
+  Read(begin, digits.size(), &digits[0]);
+  return digits;
+}
+
+int64 DigitFile::Verify(const int64 num_threads) const {
+  if (!packed_)
+    return -1;
+
+  const uint64* limbs = reinterpret_cast<const uint64*>(data_ + data_offset_);
+  const uint64* checksums =
+      reinterpret_cast<const uint64*>(data_ + index_offset_);
+  const int64 num_blocks = (num_limbs_ + block_limbs_ - 1) / block_limbs_;
+  const int64 num_tasks = std::max<int64>(1, std::min(num_threads, num_blocks));
+
+  // Each task checks a continuous range of blocks, and stops at the first
+  // broken one.
+  std::vector<int64> broken(num_tasks, num_blocks);
+  std::vector<std::function<void()>> tasks;
+  for (int64 i = 0; i < num_tasks; ++i) {
+    tasks.push_back([&, i] {
+      const int64 end = num_blocks * (i + 1) / num_tasks;
+      for (int64 j = num_blocks * i / num_tasks; j < end; ++j) {
+        const int64 n = std::min(block_limbs_, num_limbs_ - j * block_limbs_);
+        if (PackedChecksum(limbs + j * block_limbs_, n, kPackedChecksumSeed) !=
+            checksums[j]) {
+          broken[i] = j;
+          break;
+        }
+      }
+    });
+  }
+  base::ThreadPool pool(num_tasks);
+  pool.Run(tasks);
+
+  const int64 first = *std::min_element(broken.begin(), broken.end());
+  if (first == num_blocks)
+    return -1;
+  return first * block_limbs_ * digits_per_limb_;
+}
+
+bool DigitFile::ParsePacked() {
+  PackedHeader header;
+  std::memcpy(&header, data_, sizeof(header));
+  if (header.version != kPackedVersion)
+    return false;
+  if (header.base != 16 && header.base != 10)
+    return false;
+  if (header.text_size > kPackedDataOffset - sizeof(header))
+    return false;
+  if (header.block_limbs == 0)
+    return false;
+
+  base_ = header.base;
+  digits_per_limb_ = (base_ == 16) ? 16 : 19;
+  if (header.digits_per_limb != static_cast<uint64>(digits_per_limb_))
+    return false;
+  header_.assign(data_ + sizeof(header), header.text_size);
+  data_offset_ = kPackedDataOffset;
+  num_limbs_ = header.num_limbs;
+  block_limbs_ = header.block_limbs;
+  index_offset_ = header.index_offset;
+
+  const int64 num_blocks = (num_limbs_ + block_limbs_ - 1) / block_limbs_;
+  if (index_offset_ != data_offset_ + num_limbs_ * 8 ||
+      index_offset_ + num_blocks * 8 > size_)
+    return false;
+  num_digits_ = num_limbs_ * digits_per_limb_;
+  return true;
+}
+
+void DigitFile::ParseText() {
+  // The header is the first line, and each line has kDigitsPerLine digits
+  // after it.
+  const char* end = static_cast<const char*>(std::memchr(data_, '\n', size_));
+  data_offset_ = end ? end - data_ + 1 : size_;
+  header_.assign(data_, data_offset_);
+
+  const int64 size = size_ - data_offset_;
+  const int64 line_size = DigitWriter::kDigitsPerLine + 1;
+  const int64 rest = size % line_size;
+  num_digits_ = size / line_size * DigitWriter::kDigitsPerLine + rest;
+  if (rest && data_[size_ - 1] == '\n')
+    --num_digits_;
+}
+
+}  // namespace pi
+}  // namespace ppi
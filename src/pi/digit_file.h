@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+
+#include "base/base.h"
+
+namespace ppi {
+namespace pi {
+
+// A packed digit file keeps limbs in binary, instead of text lines.
+//   [0, kPackedDataOffset)  PackedHeader, followed by the text header
+//   [kPackedDataOffset, index_offset)
+//                           limbs from the leading one, 8 bytes each in the
+//                           little endian
+//   [index_offset, EOF)     a checksum for each |block_limbs| limbs
+// A limb has |digits_per_limb| digits, and the k-th digit is in the
+// (k / digits_per_limb)-th limb, so a range of digits is read in a pread().
+struct PackedHeader {
+  char magic[8];
+  uint32 version;
+  // 16 or 10.
+  uint32 base;
+  uint32 digits_per_limb;
+  // Size of the text header, e.g. "pi = 3.\n", which follows this struct.
+  uint32 text_size;
+  uint64 block_limbs;
+  uint64 num_limbs;
+  uint64 index_offset;
+};
+
+constexpr char kPackedMagic[8] = {'P', 'P', 'I', 'D', 'I', 'G', 'I', 'T'};
+constexpr uint32 kPackedVersion = 1;
+constexpr int64 kPackedDataOffset = 4096;
+constexpr int64 kPackedBlockLimbs = 1 << 20;
+constexpr uint64 kPackedChecksumSeed = 0x243F6A8885A308D3ULL;
+
+// Updates a checksum |sum| with |n| limbs.  Checksums of a block can be
+// computed in pieces, starting from kPackedChecksumSeed.
+uint64 PackedChecksum(const uint64* limbs, const int64 n, uint64 sum);
+
+// DigitFile reads digits under the point from a file of DigitWriter, in
+// text or in the packed layout.  The file is memory-mapped, and any range
+// of digits is located in O(1).
+class DigitFile {
+ public:
+  // Maps |filename|.  If it is not readable, or is broken, ok() is false.
+  explicit DigitFile(const std::string& filename);
+  DigitFile(const DigitFile&) = delete;
+  DigitFile& operator=(const DigitFile&) = delete;
+  ~DigitFile();
+
+  bool ok() const { return data_ != nullptr; }
+  bool packed() const { return packed_; }
+  // 16 or 10 in packed files.  Text files do not record it, and it is 0.
+  int base() const { return base_; }
+  // The header text, e.g. "pi = 3.\n".
+  const std::string& header() const { return header_; }
+  int64 num_digits() const { return num_digits_; }
+
+  // Copies digits in [begin, begin + n) into |out| as characters, and
+  // returns the number of copied digits, which is smaller than |n| at the
+  // end of the file.  Nothing is copied if |n| is not positive.
+  int64 Read(const int64 begin, const int64 n, char* out) const;
+  std::string Read(const int64 begin, const int64 n) const;
+
+  // Checks checksums of blocks in |num_threads| threads, and returns the
+  // first digit of the first broken block, or -1 if all blocks match.
+  // Text files have no checksums, and always pass.
+  int64 Verify(const int64 num_threads = 1) const;
+
+ private:
+  bool ParsePacked();
+  void ParseText();
+
+  const char* data_;
+  int64 size_;
+  bool packed_;
+  int base_;
+  int64 digits_per_limb_;
+  std::string header_;
+  // Offset of the first digit in text, or of the first limb.
+  int64 data_offset_;
+  int64 num_digits_;
+  int64 num_limbs_;
+  int64 block_limbs_;
+  int64 index_offset_;
+};
+
+}  // namespace pi
+}  // namespace ppi
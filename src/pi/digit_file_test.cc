@@ -0,0 +1,107 @@
+#include "pi/digit_file.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "base/base.h"
+#include "pi/digit_writer.h"
+
+namespace ppi {
+namespace pi {
+
+namespace {
+
+// Writes |limbs| into |filename|, and returns all the digits.
+std::string WriteDigits(const std::string& filename,
+                        const number::Integer::Base base,
+                        const DigitWriter::Layout layout,
+                        const std::vector<uint64>& limbs) {
+  DigitWriter writer(filename, base, 1, false, layout);
+  writer.WriteHeader("pi = 3.\n");
+  writer.Write(limbs.data(), limbs.size());
+  writer.Close();
+
+  const bool hex = (base == number::Integer::Base::kHex);
+  std::string digits;
+  char buffer[24];
+  for (uint64 limb : limbs) {
+    if (hex)
+      DigitWriter::FormatHex(limb, buffer);
+    else
+      DigitWriter::FormatDecimal(limb, buffer);
+    digits.append(buffer, hex ? 16 : 19);
+  }
+  return digits;
+}
+
+}  // namespace
+
+TEST(DigitFileTest, Read) {
+  const std::string filename = "digit_file_test_read.txt";
+  std::vector<uint64> limbs;
+  for (uint64 i = 0; i < 1000; ++i)
+    limbs.push_back(i * 0x0123456789ABCDEFULL % 10000000000000000000ULL);
+
+  for (auto base : {number::Integer::Base::kHex,
+                    number::Integer::Base::kDecimal}) {
+    for (auto layout :
+         {DigitWriter::Layout::kText, DigitWriter::Layout::kPacked}) {
+      const std::string digits = WriteDigits(filename, base, layout, limbs);
+      DigitFile file(filename);
+      ASSERT_TRUE(file.ok());
+      EXPECT_EQ(layout == DigitWriter::Layout::kPacked, file.packed());
+      EXPECT_EQ("pi = 3.\n", file.header());
+      ASSERT_EQ(static_cast<int64>(digits.size()), file.num_digits());
+
+      // Ranges cross lines and limbs.
+      for (int64 begin : {0, 1, 15, 99, 100, 12345}) {
+        for (int64 n : {1, 19, 250}) {
+          EXPECT_EQ(digits.substr(begin, n), file.Read(begin, n))
+              << "for begin = " << begin << ", n = " << n;
+        }
+      }
+      // Ranges are cut at the end.
+      EXPECT_EQ(digits.substr(digits.size() - 7),
+                file.Read(digits.size() - 7, 50));
+      EXPECT_EQ(digits.substr(5), file.Read(5, 100000000000LL));
+      EXPECT_EQ("", file.Read(digits.size(), 10));
+      EXPECT_EQ("", file.Read(-1, 10));
+      EXPECT_EQ("", file.Read(10, 0));
+      EXPECT_EQ("", file.Read(10, -5));
+      EXPECT_EQ(-1, file.Verify(2));
+    }
+  }
+  std::remove(filename.c_str());
+}
+
+TEST(DigitFileTest, Verify) {
+  const std::string filename = "digit_file_test_verify.bin";
+  std::vector<uint64> limbs(2 * kPackedBlockLimbs + 3);
+  for (size_t i = 0; i < limbs.size(); ++i)
+    limbs[i] = i * 0x9E3779B97F4A7C15ULL;
+  WriteDigits(filename, number::Integer::Base::kHex,
+              DigitWriter::Layout::kPacked, limbs);
+  {
+    DigitFile file(filename);
+    ASSERT_TRUE(file.ok());
+    EXPECT_EQ(-1, file.Verify(4));
+  }
+
+  // Break a limb in the second block.
+  {
+    std::fstream fs(filename, std::ios::in | std::ios::out | std::ios::binary);
+    fs.seekp(kPackedDataOffset + (kPackedBlockLimbs + 10) * sizeof(uint64));
+    fs.put('x');
+  }
+  DigitFile file(filename);
+  ASSERT_TRUE(file.ok());
+  EXPECT_EQ(kPackedBlockLimbs * 16, file.Verify(4));
+  std::remove(filename.c_str());
+}
+
+}  // namespace pi
+}  // namespace ppi
@@ -0,0 +1,353 @@
+#include "pi/digit_writer.h"
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "pi/digit_file.h"
+
+namespace ppi {
+namespace pi {
+
+namespace {
+
+// Size of an output block.  Two blocks are filled and written in turn.
+const int64 kBlockSize = 32 << 20;
+// Alignment of blocks, and of sizes of writes with O_DIRECT.
+const int64 kAlignment = 4096;
+// Each task formats at least this number of digits.
+const int64 kMinDigitsPerTask = 1 << 20;
+
+// Tables of 2 digits for each value in [0, 100) and [0, 0x100).
+struct DigitTables {
+  DigitTables() {
+    static const char kHexDigits[] = "0123456789ABCDEF";
+    for (int i = 0; i < 100; ++i) {
+      decimal[2 * i] = '0' + i / 10;
+      decimal[2 * i + 1] = '0' + i % 10;
+    }
+    for (int i = 0; i < 0x100; ++i) {
+      hex[2 * i] = kHexDigits[i >> 4];
+      hex[2 * i + 1] = kHexDigits[i & 0xf];
+    }
+  }
+
+  char decimal[200];
+  char hex[512];
+};
+
+const DigitTables kTables;
+
+// Formats |v| < 10^4 in 4 digits.
+inline void Format4(const uint32 v, char* out) {
+  std::memcpy(out, &kTables.decimal[2 * (v / 100)], 2);
+  std::memcpy(out + 2, &kTables.decimal[2 * (v % 100)], 2);
+}
+
+// Formats |v| < 10^8 in 8 digits.
+inline void Format8(const uint32 v, char* out) {
+  Format4(v / 10000, out);
+  Format4(v % 10000, out + 4);
+}
+
+// Returns the offset of the |digit|-th digit in bytes, including newlines.
+inline int64 ByteOffset(const int64 digit) {
+  return digit + digit / DigitWriter::kDigitsPerLine;
+}
+
+}  // namespace
+
+DigitWriter::DigitWriter(const std::string& filename,
+                         const number::Integer::Base base,
+                         const int64 num_threads,
+                         const bool direct,
+                         const Layout layout)
+    : fd_(-1),
+      direct_(false),
+      base_(base),
+      digits_per_limb_(base == number::Integer::Base::kHex ? 16 : 19),
+      layout_(layout),
+      pool_(num_threads),
+      current_(0),
+      fill_(0),
+      num_digits_(0),
+      checksum_(kPackedChecksumSeed) {
+  const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#if defined(O_DIRECT)
+  // Some file systems do not support O_DIRECT.  Fall back to buffered
+  // writes on them.
+  if (direct) {
+    fd_ = open(filename.c_str(), flags | O_DIRECT, 0644);
+    direct_ = (fd_ >= 0);
+  }
+#endif
+  if (fd_ < 0)
+    fd_ = open(filename.c_str(), flags, 0644);
+  PCHECK(fd_ >= 0) << "Failed to open " << filename;
+
+  for (int i = 0; i < 2; ++i) {
+    memory_[i].reset(new char[kBlockSize + kAlignment]);
+    const uintptr_t address = reinterpret_cast<uintptr_t>(memory_[i].get());
+    blocks_[i] =
+        memory_[i].get() + (kAlignment - address % kAlignment) % kAlignment;
+  }
+
+  // The header is written in Close(), when all sizes are fixed.
+  if (layout_ == Layout::kPacked) {
+    std::memset(blocks_[current_], 0, kPackedDataOffset);
+    fill_ = kPackedDataOffset;
+  }
+}
+
+DigitWriter::~DigitWriter() {
+  if (fd_ >= 0)
+    Close();
+}
+
+void DigitWriter::WriteHeader(const std::string& text) {
+  DCHECK_EQ(0, num_digits_);
+  if (layout_ == Layout::kPacked) {
+    text_ += text;
+    return;
+  }
+  Append(text.data(), text.size());
+}
+
+void DigitWriter::Write(const uint64* limbs, const int64 n) {
+  WriteLimbs(limbs, n, false);
+}
+
+void DigitWriter::WriteReverse(const uint64* limbs, const int64 n) {
+  WriteLimbs(limbs, n, true);
+}
+
+void DigitWriter::Close() {
+  DCHECK_GE(fd_, 0);
+  if (layout_ == Layout::kPacked) {
+    if ((num_digits_ / digits_per_limb_) % kPackedBlockLimbs)
+      checksums_.push_back(checksum_);
+    Append(reinterpret_cast<const char*>(checksums_.data()),
+           checksums_.size() * sizeof(uint64));
+  } else if (num_digits_ % kDigitsPerLine) {
+    Append("\n", 1);
+  }
+  if (flusher_.joinable())
+    flusher_.join();
+#if defined(O_DIRECT)
+  // The last write can be unaligned.
+  if (direct_ && fill_ % kAlignment) {
+    PCHECK(fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT) == 0);
+    direct_ = false;
+  }
+#endif
+  WriteBlock(blocks_[current_], fill_);
+  fill_ = 0;
+  if (layout_ == Layout::kPacked)
+    WritePackedHeader();
+  PCHECK(close(fd_) == 0);
+  fd_ = -1;
+}
+
+void DigitWriter::FormatHex(uint64 limb, char* out) {
+  for (int i = 0; i < 8; ++i) {
+    const uint64 byte = (limb >> (56 - 8 * i)) & 0xff;
+    std::memcpy(out + 2 * i, &kTables.hex[2 * byte], 2);
+  }
+}
+
+void DigitWriter::FormatDecimal(uint64 limb, char* out) {
+  DCHECK_LT(limb, 10000000000000000000ULL);
+  const uint32 high = limb / 10000000000000000ULL;
+  const uint64 low = limb % 10000000000000000ULL;
+  out[0] = '0' + high / 100;
+  std::memcpy(out + 1, &kTables.decimal[2 * (high % 100)], 2);
+  Format8(low / 100000000, out + 3);
+  Format8(low % 100000000, out + 11);
+}
+
+void DigitWriter::WriteLimbs(const uint64* limbs,
+                             const int64 n,
+                             const bool reverse) {
+  // A limb takes at most |digits_per_limb_| + 1 bytes with a newline in
+  // text.
+  const int64 limb_size =
+      (layout_ == Layout::kPacked) ? sizeof(uint64) : digits_per_limb_ + 1;
+  int64 rest = n;
+  while (rest > 0) {
+    const int64 k = std::min(rest, (kBlockSize - fill_) / limb_size);
+    if (k == 0) {
+      Flush();
+      continue;
+    }
+    // Limbs in the output order are [n - rest, n - rest + k).
+    const uint64* p = reverse ? limbs + rest - k : limbs + n - rest;
+    if (layout_ == Layout::kPacked)
+      Pack(p, k, reverse);
+    else
+      Format(p, k, reverse);
+    rest -= k;
+  }
+}
+
+void DigitWriter::Format(const uint64* limbs,
+                         const int64 n,
+                         const bool reverse) {
+  char* out = blocks_[current_] + fill_;
+  const int64 end_digit = num_digits_ + n * digits_per_limb_;
+  const int64 num_tasks =
+      std::min(pool_.num_threads(), n * digits_per_limb_ / kMinDigitsPerTask);
+
+  if (num_tasks <= 1) {
+    FormatRange(limbs, n, reverse, 0, n, num_digits_, out);
+  } else {
+    // Limbs in each task start at a known digit, so tasks fill separate
+    // ranges in the block.
+    std::vector<std::function<void()>> tasks;
+    for (int64 i = 0; i < num_tasks; ++i) {
+      const int64 begin = n * i / num_tasks;
+      const int64 end = n * (i + 1) / num_tasks;
+      const int64 digit = num_digits_ + begin * digits_per_limb_;
+      char* const p = out + ByteOffset(digit) - ByteOffset(num_digits_);
+      tasks.push_back([this, limbs, n, reverse, begin, end, digit, p] {
+        FormatRange(limbs, n, reverse, begin, end, digit, p);
+      });
+    }
+    pool_.Run(tasks);
+  }
+
+  fill_ += ByteOffset(end_digit) - ByteOffset(num_digits_);
+  num_digits_ = end_digit;
+}
+
+void DigitWriter::FormatRange(const uint64* limbs,
+                              const int64 n,
+                              const bool reverse,
+                              const int64 begin,
+                              const int64 end,
+                              int64 digit,
+                              char* out) const {
+  const bool hex = (base_ == number::Integer::Base::kHex);
+  const int64 width = digits_per_limb_;
+  char buffer[24];
+  for (int64 i = begin; i < end; ++i) {
+    const uint64 limb = reverse ? limbs[n - 1 - i] : limbs[i];
+    const int64 column = digit % kDigitsPerLine;
+    if (column + width < kDigitsPerLine) {
+      if (hex)
+        FormatHex(limb, out);
+      else
+        FormatDecimal(limb, out);
+      out += width;
+    } else {
+      // The limb reaches the end of a line.
+      if (hex)
+        FormatHex(limb, buffer);
+      else
+        FormatDecimal(limb, buffer);
+      const int64 head = kDigitsPerLine - column;
+      std::memcpy(out, buffer, head);
+      out[head] = '\n';
+      std::memcpy(out + head + 1, buffer + head, width - head);
+      out += width + 1;
+    }
+    digit += width;
+  }
+}
+
+void DigitWriter::Pack(const uint64* limbs,
+                       const int64 n,
+                       const bool reverse) {
+  // |fill_| is a multiple of 8 in the packed layout.
+  uint64* out = reinterpret_cast<uint64*>(blocks_[current_] + fill_);
+  if (reverse) {
+    for (int64 i = 0; i < n; ++i)
+      out[i] = limbs[n - 1 - i];
+  } else {
+    std::memcpy(out, limbs, n * sizeof(uint64));
+  }
+
+  int64 index = num_digits_ / digits_per_limb_;
+  for (int64 i = 0; i < n;) {
+    const int64 k =
+        std::min(n - i, kPackedBlockLimbs - index % kPackedBlockLimbs);
+    checksum_ = PackedChecksum(out + i, k, checksum_);
+    i += k;
+    index += k;
+    if (index % kPackedBlockLimbs == 0) {
+      checksums_.push_back(checksum_);
+      checksum_ = kPackedChecksumSeed;
+    }
+  }
+
+  fill_ += n * sizeof(uint64);
+  num_digits_ += n * digits_per_limb_;
+}
+
+void DigitWriter::Append(const char* data, int64 size) {
+  while (size > 0) {
+    if (fill_ == kBlockSize)
+      Flush();
+    const int64 n = std::min(size, kBlockSize - fill_);
+    std::memcpy(blocks_[current_] + fill_, data, n);
+    fill_ += n;
+    data += n;
+    size -= n;
+  }
+}
+
+void DigitWriter::Flush() {
+  // With O_DIRECT, an unaligned tail is moved to the next block.
+  const int64 size = direct_ ? fill_ / kAlignment * kAlignment : fill_;
+  if (flusher_.joinable())
+    flusher_.join();
+  const char* block = blocks_[current_];
+  current_ ^= 1;
+  fill_ -= size;
+  std::memcpy(blocks_[current_], block + size, fill_);
+  flusher_ = std::thread([this, block, size] { WriteBlock(block, size); });
+}
+
+void DigitWriter::WriteBlock(const char* data, int64 size) {
+  while (size > 0) {
+    const ssize_t written = write(fd_, data, size);
+    if (written < 0 && errno == EINTR)
+      continue;
+    PCHECK(written > 0) << "Failed to write digits";
+    data += written;
+    size -= written;
+  }
+}
+
+void DigitWriter::WritePackedHeader() {
+  const int64 num_limbs = num_digits_ / digits_per_limb_;
+  PackedHeader header;
+  std::memcpy(header.magic, kPackedMagic, sizeof(header.magic));
+  header.version = kPackedVersion;
+  header.base = (base_ == number::Integer::Base::kHex) ? 16 : 10;
+  header.digits_per_limb = digits_per_limb_;
+  header.text_size = text_.size();
+  header.block_limbs = kPackedBlockLimbs;
+  header.num_limbs = num_limbs;
+  header.index_offset = kPackedDataOffset + num_limbs * sizeof(uint64);
+  CHECK_LE(sizeof(header) + text_.size(), kPackedDataOffset)
+      << "Too long text header";
+
+  // The head of the file is written in an aligned page, even with
+  // O_DIRECT.
+  char* page = blocks_[current_];
+  std::memset(page, 0, kPackedDataOffset);
+  std::memcpy(page, &header, sizeof(header));
+  std::memcpy(page + sizeof(header), text_.data(), text_.size());
+  PCHECK(pwrite(fd_, page, kPackedDataOffset, 0) == kPackedDataOffset)
+      << "Failed to write the header";
+}
+
+}  // namespace pi
+}  // namespace ppi
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/base.h"
+#include "base/thread_pool.h"
+#include "number/integer.h"
+
+namespace ppi {
+namespace pi {
+
+// DigitWriter writes limbs into a file as digits, in lines of
+// |kDigitsPerLine| digits, or in the packed format in pi/digit_file.h.
+// Limbs are formatted with digit tables into large output blocks, in
+// parallel for large inputs, and a block is written in a background thread
+// while the next one is filled.
+class DigitWriter {
+ public:
+  static constexpr int64 kDigitsPerLine = 100;
+
+  enum class Layout {
+    kText,
+    kPacked,
+  };
+
+  // Opens |filename| to write limbs in |base|.  If |direct| is set, blocks
+  // are written with O_DIRECT where it is supported, to bypass the page
+  // cache.
+  DigitWriter(const std::string& filename,
+              const number::Integer::Base base,
+              const int64 num_threads = 1,
+              const bool direct = false,
+              const Layout layout = Layout::kText);
+  // Closes the file, if Close() is not called.
+  ~DigitWriter();
+
+  // Writes |text| as is.  It has to come before any digits.  In the packed
+  // layout, it is kept in the file header.
+  void WriteHeader(const std::string& text);
+  // Writes |n| limbs in the order of limbs[0], limbs[1], ...
+  void Write(const uint64* limbs, const int64 n);
+  // Writes |n| limbs in the order of limbs[n-1], ..., limbs[0], i.e. limbs
+  // of an Integer from the leading one.
+  void WriteReverse(const uint64* limbs, const int64 n);
+  // Terminates the last line, or writes checksums and the header in the
+  // packed layout, and closes the file.
+  void Close();
+
+  int64 num_digits() const { return num_digits_; }
+
+  // Formats |limb| in 16 hexadecimal digits, or in 19 decimal digits with
+  // leading zeros.  Output is not terminated.
+  static void FormatHex(uint64 limb, char* out);
+  static void FormatDecimal(uint64 limb, char* out);
+
+ private:
+  // Writes limbs in [0, n) of |limbs|, starting from limbs[0] or from
+  // limbs[n-1] in |reverse|.
+  void WriteLimbs(const uint64* limbs, const int64 n, const bool reverse);
+  // Formats |n| limbs, which starts from limbs[0] or limbs[n-1] in
+  // |reverse|, into the current block.
+  void Format(const uint64* limbs, const int64 n, const bool reverse);
+  // Copies |n| limbs into the current block in the packed layout, and
+  // updates checksums.
+  void Pack(const uint64* limbs, const int64 n, const bool reverse);
+  // Formats limbs in [begin, end) of Format().  The first one is the
+  // |digit|-th digit, and is put at |out|.
+  void FormatRange(const uint64* limbs,
+                   const int64 n,
+                   const bool reverse,
+                   const int64 begin,
+                   const int64 end,
+                   int64 digit,
+                   char* out) const;
+  // Passes the current block to the background thread, and switches to
+  // the other block.
+  void Flush();
+  void Append(const char* data, int64 size);
+  void WriteBlock(const char* data, int64 size);
+  // Writes the header of the packed layout at the head of the file.
+  void WritePackedHeader();
+
+  int fd_;
+  bool direct_;
+  const number::Integer::Base base_;
+  const int64 digits_per_limb_;
+  const Layout layout_;
+  base::ThreadPool pool_;
+
+  std::unique_ptr<char[]> memory_[2];
+  char* blocks_[2];
+  int current_;
+  int64 fill_;
+  int64 num_digits_;
+  std::thread flusher_;
+
+  // For the packed layout.
+  std::string text_;
+  uint64 checksum_;
+  std::vector<uint64> checksums_;
+};
+
+}  // namespace pi
+}  // namespace ppi
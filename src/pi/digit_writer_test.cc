@@ -0,0 +1,134 @@
+#include "pi/digit_writer.h"
+
+#include <gtest/gtest.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "base/base.h"
+#include "pi/digit_file.h"
+
+namespace ppi {
+namespace pi {
+
+namespace {
+
+std::string ReadFile(const std::string& filename) {
+  std::ifstream ifs(filename);
+  std::ostringstream oss;
+  oss << ifs.rdbuf();
+  return oss.str();
+}
+
+// Formats |limbs| with sprintf() in lines of 100 digits.
+std::string Expect(const std::string& header,
+                   const std::vector<uint64>& limbs,
+                   const char* format) {
+  std::string digits;
+  char buffer[32];
+  for (uint64 limb : limbs) {
+    std::sprintf(buffer, format, limb);
+    digits += buffer;
+  }
+  std::string expect = header;
+  for (size_t i = 0; i < digits.size(); i += DigitWriter::kDigitsPerLine)
+    expect += digits.substr(i, DigitWriter::kDigitsPerLine) + "\n";
+  return expect;
+}
+
+}  // namespace
+
+TEST(DigitWriterTest, Format) {
+  char buffer[20] = {};
+  DigitWriter::FormatHex(0x0123456789ABCDEFULL, buffer);
+  EXPECT_EQ("0123456789ABCDEF", std::string(buffer, 16));
+  DigitWriter::FormatDecimal(9876543210123456789ULL, buffer);
+  EXPECT_EQ("9876543210123456789", std::string(buffer, 19));
+  DigitWriter::FormatDecimal(42, buffer);
+  EXPECT_EQ("0000000000000000042", std::string(buffer, 19));
+}
+
+TEST(DigitWriterTest, Decimal) {
+  const std::string filename = "digit_writer_test_decimal.txt";
+  std::vector<uint64> limbs;
+  for (uint64 i = 0; i < 300000; ++i)
+    limbs.push_back(i * 33333333333333ULL % 10000000000000000000ULL);
+
+  // Large inputs are formatted in parallel.
+  DigitWriter writer(filename, number::Integer::Base::kDecimal, 4);
+  writer.WriteHeader("pi = 3.\n");
+  writer.Write(limbs.data(), 7);
+  writer.Write(limbs.data() + 7, limbs.size() - 7);
+  writer.Close();
+
+  EXPECT_EQ(static_cast<int64>(limbs.size()) * 19, writer.num_digits());
+  EXPECT_EQ(Expect("pi = 3.\n", limbs, "%019" PRIu64), ReadFile(filename));
+  std::remove(filename.c_str());
+}
+
+TEST(DigitWriterTest, HexReverse) {
+  const std::string filename = "digit_writer_test_hex.txt";
+  std::vector<uint64> limbs;
+  for (uint64 i = 0; i < 1001; ++i)
+    limbs.push_back(i * 0x0123456789ABCDEFULL);
+
+  DigitWriter writer(filename, number::Integer::Base::kHex);
+  writer.WriteHeader("pi = 3.\n");
+  writer.WriteReverse(limbs.data(), limbs.size());
+  writer.Close();
+
+  std::vector<uint64> reversed(limbs.rbegin(), limbs.rend());
+  EXPECT_EQ(Expect("pi = 3.\n", reversed, "%016" PRIX64), ReadFile(filename));
+  std::remove(filename.c_str());
+}
+
+TEST(DigitWriterTest, Packed) {
+  const std::string filename = "digit_writer_test_packed.bin";
+  std::vector<uint64> limbs;
+  for (int64 i = 0; i < kPackedBlockLimbs + 5; ++i)
+    limbs.push_back(i * 0x0123456789ABCDEFULL);
+
+  DigitWriter writer(filename, number::Integer::Base::kHex, 1, false,
+                     DigitWriter::Layout::kPacked);
+  writer.WriteHeader("pi = 3.\n");
+  writer.Write(limbs.data(), 3);
+  writer.Write(limbs.data() + 3, limbs.size() - 3);
+  writer.Close();
+
+  const std::string content = ReadFile(filename);
+  PackedHeader header;
+  ASSERT_LE(sizeof(header), content.size());
+  std::memcpy(&header, content.data(), sizeof(header));
+  EXPECT_EQ(0, std::memcmp(kPackedMagic, header.magic, sizeof(header.magic)));
+  EXPECT_EQ(16U, header.base);
+  EXPECT_EQ(16U, header.digits_per_limb);
+  EXPECT_EQ("pi = 3.\n",
+            content.substr(sizeof(header), header.text_size));
+  EXPECT_EQ(limbs.size(), header.num_limbs);
+  EXPECT_EQ(kPackedDataOffset + limbs.size() * sizeof(uint64),
+            header.index_offset);
+
+  // Limbs and 2 checksums follow the header.
+  ASSERT_EQ(header.index_offset + 2 * sizeof(uint64), content.size());
+  std::vector<uint64> data(limbs.size() + 2);
+  std::memcpy(data.data(), content.data() + kPackedDataOffset,
+              data.size() * sizeof(uint64));
+  for (size_t i = 0; i < limbs.size(); ++i) {
+    ASSERT_EQ(limbs[i], data[i]) << "for i = " << i;
+  }
+  EXPECT_EQ(PackedChecksum(limbs.data(), kPackedBlockLimbs,
+                           kPackedChecksumSeed),
+            data[limbs.size()]);
+  EXPECT_EQ(PackedChecksum(limbs.data() + kPackedBlockLimbs, 5,
+                           kPackedChecksumSeed),
+            data[limbs.size() + 1]);
+  std::remove(filename.c_str());
+}
+
+}  // namespace pi
+}  // namespace ppi
@@ -0,0 +1,156 @@
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/base.h"
+#include "base/thread_pool.h"
+#include "pi/digit_file.h"
+
+DEFINE_string(file,
+              "pi10.txt",
+              "Digit file written by ppi, in text or in the packed format");
+DEFINE_string(queries,
+              "",
+              "File of queries.  Each line has the position of the first "
+              "digit, where 0 is the first digit under the point, and the "
+              "number of digits.  Queries are read from stdin, if it is "
+              "empty and no query is given in arguments.");
+DEFINE_bool(verify, false, "Verify checksums of a packed file");
+DEFINE_int32(threads, 0, "Number of threads. 0 means the number of CPU cores.");
+
+using ppi::int64;
+
+namespace {
+
+// Number of queries which are answered at once.
+constexpr size_t kBatchSize = 1 << 16;
+
+struct Query {
+  int64 begin;
+  int64 count;
+};
+
+// Returns whether |query| starts at a digit in |file| and asks a
+// non-negative number of digits, and reports it otherwise.
+bool IsValid(const ppi::pi::DigitFile& file, const Query& query) {
+  if (query.begin < 0 || query.begin >= file.num_digits()) {
+    std::cerr << "Position out of [0, " << file.num_digits()
+              << "): " << query.begin << " " << query.count << "\n";
+    return false;
+  }
+  if (query.count < 0) {
+    std::cerr << "Negative number of digits: " << query.begin << " "
+              << query.count << "\n";
+    return false;
+  }
+  return true;
+}
+
+// Answers |queries| in parallel, and prints them in the given order.
+void Answer(const ppi::pi::DigitFile& file,
+            const std::vector<Query>& queries,
+            ppi::base::ThreadPool& pool) {
+  if (queries.empty())
+    return;
+  std::vector<std::string> answers(queries.size());
+  const int64 num_tasks = std::min<int64>(pool.num_threads(), queries.size());
+  std::vector<std::function<void()>> tasks;
+  for (int64 i = 0; i < num_tasks; ++i) {
+    tasks.push_back([&, i] {
+      const int64 end = queries.size() * (i + 1) / num_tasks;
+      for (int64 j = queries.size() * i / num_tasks; j < end; ++j) {
+        const Query& query = queries[j];
+        answers[j] = std::to_string(query.begin) + " " +
+                     file.Read(query.begin, query.count) + "\n";
+      }
+    });
+  }
+  pool.Run(tasks);
+  for (const std::string& answer : answers)
+    std::fwrite(answer.data(), 1, answer.size(), stdout);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::SetUsageMessage("ppi_digits [<first digit> <number of digits>]...");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  ppi::pi::DigitFile file(FLAGS_file);
+  if (!file.ok()) {
+    std::cerr << "Failed to read " << FLAGS_file << "\n";
+    return 1;
+  }
+  const int64 num_threads =
+      (FLAGS_threads > 0) ? FLAGS_threads
+                          : std::max(1u, std::thread::hardware_concurrency());
+  ppi::base::ThreadPool pool(num_threads);
+
+  if (FLAGS_verify) {
+    const int64 broken = file.Verify(num_threads);
+    if (broken >= 0) {
+      std::cerr << "Checksum mismatch in a block from digit " << broken << "\n";
+      return 1;
+    }
+    std::cerr << "Verified " << file.num_digits() << " digits.\n";
+  }
+
+  std::vector<Query> queries;
+  if (argc > 1) {
+    if (argc % 2 == 0) {
+      std::cerr << "No number of digits for " << argv[argc - 1] << "\n";
+      return 1;
+    }
+    for (int i = 1; i + 1 < argc; i += 2) {
+      const Query query{std::strtoll(argv[i], nullptr, 10),
+                        std::strtoll(argv[i + 1], nullptr, 10)};
+      if (!IsValid(file, query))
+        return 1;
+      queries.push_back(query);
+    }
+    Answer(file, queries, pool);
+    return 0;
+  }
+  if (FLAGS_verify && FLAGS_queries.empty())
+    return 0;
+
+  std::FILE* input =
+      FLAGS_queries.empty() ? stdin : std::fopen(FLAGS_queries.c_str(), "r");
+  if (!input) {
+    std::cerr << "Failed to open " << FLAGS_queries << "\n";
+    return 1;
+  }
+  Query query;
+  int scanned;
+  while ((scanned = std::fscanf(input, "%" SCNd64 " %" SCNd64, &query.begin,
+                                &query.count)) == 2) {
+    if (!IsValid(file, query)) {
+      Answer(file, queries, pool);
+      return 1;
+    }
+    queries.push_back(query);
+    if (queries.size() == kBatchSize) {
+      Answer(file, queries, pool);
+      queries.clear();
+    }
+  }
+  Answer(file, queries, pool);
+  if (input != stdin)
+    std::fclose(input);
+  if (scanned != EOF) {
+    std::cerr << "Malformed query at the end of the input\n";
+    return 1;
+  }
+
+  return 0;
+}
@@ -1,29 +1,79 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
-#include <cstdio>
-#include <fstream>
+#include <algorithm>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
 
 #include "base/allocator.h"
 #include "base/base.h"
 #include "base/timer.h"
 #include "drm/chudnovsky.h"
 #include "drm/drm.h"
+#include "number/mult_stats.h"
 #include "number/real.h"
 #include "pi/arctan.h"
+#include "pi/digit_writer.h"
 
-DEFINE_int32(type, 0, "0:Chudnovsky, 1:Machin");
+DEFINE_int32(type,
+             0,
+             "0:Chudnovsky, 1:Machin, 2:Machin (binary splitting), "
+             "3:Takano, 4:Stormer");
 DEFINE_int64(digits, 100, "Number of hexadeciaml digits to compute");
+DEFINE_int64(leaf_terms,
+             32,
+             "Number of terms computed at once in leaves of binary splitting");
+DEFINE_int32(threads,
+             0,
+             "Number of threads in binary splitting and radix conversion. "
+             "0 means the number of CPU cores.");
+DEFINE_bool(reduce_factors,
+            false,
+            "Cancel common factors in binary splitting");
+DEFINE_bool(check_mult,
+            false,
+            "Check products of large integers in residues, and recompute "
+            "products which fail the check");
+DEFINE_bool(fft_stats,
+            false,
+            "Count multiplications with FFT for each transform length, and "
+            "dump their time and rounding errors at exit");
+DEFINE_double(fft_error_threshold,
+              0,
+              "Rounding error in FFT, over which products in binary "
+              "splitting are recomputed in shorter transforms.  0 disables "
+              "recomputations.");
 DEFINE_string(hex_output, "pi16.txt", "File name to output pi in hexadecimal.");
 DEFINE_string(dec_output, "pi10.txt", "File name to output pi in decimal.");
+DEFINE_string(hex_reference,
+              "",
+              "File of hexadecimal digits of pi to compare with the result");
+DEFINE_string(dec_reference,
+              "",
+              "File of decimal digits of pi to compare with the result");
+DEFINE_bool(packed_output,
+            false,
+            "Write output files in the packed binary format, instead of text");
+DEFINE_bool(direct_io,
+            false,
+            "Write output files with O_DIRECT, bypassing the page cache");
 
 using ppi::int64;
+using ppi::uint64;
 
+int64 NumThreads();
+ppi::pi::DigitWriter::Layout OutputLayout();
 void ComputePi(ppi::number::Real& pi);
+void ComparePi(const ppi::number::Real& pi, const std::string& filename);
+void ReportMatched(const int64 matched, const std::string& filename);
 void DumpPiInFile(const ppi::number::Real& pi, const std::string& filename);
+void StreamDecimalPi(const ppi::number::Real& pi,
+                     const int64 precision,
+                     const std::string& filename,
+                     const std::string& reference);
 
 int main(int argc, char* argv[]) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
@@ -33,6 +83,9 @@ int main(int argc, char* argv[]) {
     FLAGS_digits = strtoll(argv[1], NULL, 10);
   }
 
+  ppi::number::Integer::setCheckMult(FLAGS_check_mult);
+  ppi::number::MultStats::setEnabled(FLAGS_fft_stats);
+
   ppi::base::Timer timer_all;
   {
     ppi::number::Real pi;
@@ -42,32 +95,46 @@ int main(int argc, char* argv[]) {
     LOG(INFO) << "Computing Time: " << timer_compute.GetTimeInSec() << " sec.";
     std::cout << "Computing Time: " << timer_compute.GetTimeInSec()
               << " sec.\n";
+    if (FLAGS_check_mult) {
+      LOG(INFO) << "Recomputed products: "
+                << ppi::number::Integer::recomputed_mults();
+    }
 
-    ppi::number::Real pi_dec(ppi::number::Integer::Base::kDecimal);
-    if (FLAGS_dec_output != "") {
+    const int64 prec_digits = (FLAGS_digits + 18) / 19;
+    if (FLAGS_hex_reference != "")
+      ComparePi(pi, FLAGS_hex_reference);
+
+    // Decimal digits are compared with the reference while they are
+    // converted for the output, without another conversion.
+    if (FLAGS_dec_output != "" || FLAGS_dec_reference != "") {
       ppi::base::Timer timer_base;
-      const int64 prec_digits = (FLAGS_digits + 18) / 19;
-      pi_dec.setPrecision(prec_digits);
-      ppi::pi::Real::ConvertBase(pi, pi_dec);
+      StreamDecimalPi(pi, prec_digits, FLAGS_dec_output, FLAGS_dec_reference);
       timer_base.Stop();
-      LOG(INFO) << "Base conversion: " << timer_base.GetTimeInSec() << " sec.";
-      std::cout << "Base conversion: " << timer_base.GetTimeInSec()
-                << " sec.\n";
+      LOG(INFO) << "Base conversion and decimal output: "
+                << timer_base.GetTimeInSec() << " sec.";
+      std::cout << "Base conversion and decimal output: "
+                << timer_base.GetTimeInSec() << " sec.\n";
     }
 
-    ppi::base::Timer timer_output;
-    DumpPiInFile(pi, FLAGS_hex_output);
-    if (FLAGS_dec_output != "") {
-      DumpPiInFile(pi_dec, FLAGS_dec_output);
+    if (FLAGS_hex_output != "") {
+      ppi::base::Timer timer_output;
+      DumpPiInFile(pi, FLAGS_hex_output);
+      timer_output.Stop();
+      LOG(INFO) << "Output: " << timer_output.GetTimeInSec() << " sec.";
+      std::cout << "Output: " << timer_output.GetTimeInSec() << " sec.\n";
     }
-    timer_output.Stop();
-    LOG(INFO) << "Output: " << timer_output.GetTimeInSec() << " sec.";
-    std::cout << "Output: " << timer_output.GetTimeInSec() << " sec.\n";
   }
   timer_all.Stop();
   LOG(INFO) << "Total elapsed Time: " << timer_all.GetTimeInSec() << " sec.";
   std::cout << "Total elapsed Time: " << timer_all.GetTimeInSec() << " sec.\n";
 
+  if (FLAGS_fft_stats) {
+    std::ostringstream oss;
+    ppi::number::MultStats::Dump(oss);
+    LOG(INFO) << "FFT statistics:\n" << oss.str();
+    std::cout << "FFT statistics:\n" << oss.str();
+  }
+
   int64 used_size = ppi::base::Allocator::allocated_size_peak();
   double used_size_mib = used_size / 1024.0 / 1024.0;
   if (used_size_mib > 1024) {
@@ -81,10 +148,25 @@ int main(int argc, char* argv[]) {
   return 0;
 }
 
+int64 NumThreads() {
+  if (FLAGS_threads > 0)
+    return FLAGS_threads;
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+ppi::pi::DigitWriter::Layout OutputLayout() {
+  return FLAGS_packed_output ? ppi::pi::DigitWriter::Layout::kPacked
+                             : ppi::pi::DigitWriter::Layout::kText;
+}
+
 void ComputePi(ppi::number::Real& pi) {
   switch (FLAGS_type) {
   case 0: {
     std::unique_ptr<ppi::drm::Drm> drm(new ppi::drm::Chudnovsky);
+    drm->setLeafTerms(FLAGS_leaf_terms);
+    drm->setReduceFactors(FLAGS_reduce_factors);
+    drm->setErrorThreshold(FLAGS_fft_error_threshold);
+    drm->setNumThreads(NumThreads());
     double error = drm->compute(FLAGS_digits, &pi);
     LOG(INFO) << "Maximum error in FFT: " << error;
     break;
@@ -93,42 +175,100 @@ void ComputePi(ppi::number::Real& pi) {
     pi.setPrecision(FLAGS_digits / 16 + 1);
     ppi::pi::Arctan::Machin(pi);
     break;
+  case 2:
+  case 3:
+  case 4: {
+    static const ppi::pi::Arctan::Formula kFormulas[] = {
+        ppi::pi::Arctan::Formula::kMachin,
+        ppi::pi::Arctan::Formula::kTakano,
+        ppi::pi::Arctan::Formula::kStormer,
+    };
+    pi.setPrecision(FLAGS_digits / 16 + 1);
+    double error = ppi::pi::Arctan::MachinLike(kFormulas[FLAGS_type - 2], pi);
+    LOG(INFO) << "Maximum error in FFT: " << error;
+    break;
+  }
   }
 }
 
+void ComparePi(const ppi::number::Real& pi, const std::string& filename) {
+  ppi::base::Timer timer;
+  const int64 matched = pi.Compare(filename, NumThreads());
+  timer.Stop();
+  LOG(INFO) << "Compare: " << timer.GetTimeInSec() << " sec.";
+  ReportMatched(matched, filename);
+}
+
+void ReportMatched(const int64 matched, const std::string& filename) {
+  LOG(INFO) << "Matched " << matched << " digits with " << filename;
+  std::cout << "Matched " << matched << " digits with " << filename << "\n";
+}
+
 void DumpPiInFile(const ppi::number::Real& pi, const std::string& filename) {
   using namespace ppi::number;
-  static constexpr int64 kDigitsPerLine = 100;
-  static char buffer[kDigitsPerLine + 50];
-  const char* fmt_digs =
-      (pi.base() == Integer::Base::kHex) ? "%016" PRIX64 : "%019" PRIu64;
-  const int64 digs_per_elem = (pi.base() == Integer::Base::kHex) ? 16 : 19;
 
   CHECK_EQ(pi[pi.size() - 1], 3);
   CHECK_EQ(pi.size() + pi.exponent(), 1);
 
-  std::ofstream ofs(filename);
-  ofs << "pi = 3.\n";
-
-  int64 offset = 0;
-  for (int64 i = pi.size() - 2; i >= 0; --i) {
-    std::sprintf(buffer + offset, fmt_digs, pi[i]);
-    offset += digs_per_elem;
-    if (offset >= kDigitsPerLine) {
-      ofs.write(buffer, kDigitsPerLine);
-      ofs.write("\n", 1);
-      for (int64 j = kDigitsPerLine; j < offset; ++j)
-        buffer[j - kDigitsPerLine] = buffer[j];
-      offset -= kDigitsPerLine;
-    }
-  }
-  if (offset) {
-    buffer[offset] = '\n';
-    ofs.write(buffer, offset + 1);
-  }
-  LOG(INFO) << "Output " << (pi.size() - 1) * digs_per_elem << " "
+  ppi::pi::DigitWriter writer(filename, pi.base(), NumThreads(),
+                              FLAGS_direct_io, OutputLayout());
+  writer.WriteHeader("pi = 3.\n");
+  writer.WriteReverse(pi.data(), pi.size() - 1);
+  writer.Close();
+  LOG(INFO) << "Output " << writer.num_digits() << " "
             << (pi.base() == Integer::Base::kHex ? "hexa" : "")
             << "decimal digits.";
+}
+
+// Converts |pi| into decimal with |precision| limbs, writes them into
+// |filename| in the format of DumpPiInFile(), and compares them with
+// |reference|.  Either of files can be empty to skip it.  Converted blocks
+// are formatted and compared as soon as they come, and the writer outputs
+// them in the background, so that the whole decimal digits are never in
+// memory.
+void StreamDecimalPi(const ppi::number::Real& pi,
+                     const int64 precision,
+                     const std::string& filename,
+                     const std::string& reference) {
+  using namespace ppi::number;
+  using ppi::pi::DigitWriter;
 
-  ofs.close();
+  int64 matched = 0;
+  Real::DecimalSink compare;
+  if (reference != "")
+    compare = Real::CompareDecimal(reference, &matched);
+  std::unique_ptr<DigitWriter> writer;
+  if (filename != "") {
+    writer.reset(new DigitWriter(filename, Integer::Base::kDecimal,
+                                 NumThreads(), FLAGS_direct_io,
+                                 OutputLayout()));
+  }
+  bool integral = true;
+  Real::ConvertToDecimal(
+      pi, precision,
+      [&](const uint64* limbs, int64 n) {
+        if (compare)
+          compare(limbs, n);
+        if (!writer)
+          return;
+        if (!integral) {
+          writer->Write(limbs, n);
+          return;
+        }
+        std::string header = "pi = " + std::to_string(limbs[0]);
+        char buffer[19];
+        for (int64 i = 1; i < n; ++i) {
+          DigitWriter::FormatDecimal(limbs[i], buffer);
+          header.append(buffer, sizeof(buffer));
+        }
+        writer->WriteHeader(header + ".\n");
+        integral = false;
+      },
+      NumThreads());
+  if (writer) {
+    writer->Close();
+    LOG(INFO) << "Output " << writer->num_digits() << " decimal digits.";
+  }
+  if (compare)
+    ReportMatched(matched, reference);
 }